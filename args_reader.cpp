@@ -5,14 +5,19 @@
 #include <stdexcept>
 #include <string>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include "args_reader.h"
 #include "file_system.h"
 
 using namespace std;
 
-void args_reader::mfs(int argc, const char **argv, int * bs, int * ic) {
-    if(argc_no != argc)
+void args_reader::mfs(int argc, const char **argv, int * bs, int * ic, format_options * format) {
+    if(argc < argc_no)
         throw invalid_argument("Invalid argument number.");
+    *format = format_options();
+    for (int i = argc_no; i < argc; ++i)
+        parse_feature(argv[i], format);
     int block_size = stoi(argv[1]);
     double log_of_b = log2(block_size);
     // if it is not a power of two
@@ -26,6 +31,9 @@ void args_reader::mfs(int argc, const char **argv, int * bs, int * ic) {
     max_i+= 32768;
     max_i-= ((double)bs_byte)/8;
     max_inode = floor(max_i);
+    // directory entries keep 2 byte i-node numbers in every format
+    if(format->features & file_system::feature_v2)
+        max_inode = UINT16_MAX;
     int cur_inode = stoi(argv[2]);
     if(max_inode < cur_inode)
         throw invalid_argument("Given I-node count is too large with the given block size..");
@@ -36,69 +44,198 @@ void args_reader::mfs(int argc, const char **argv, int * bs, int * ic) {
     *bs = block_size;
 }
 
+void args_reader::parse_feature(const string &arg, format_options * format) {
+    // features with a value are given as name=value
+    size_t eq = arg.find('=');
+    string name = arg.substr(0, eq);
+    string value = eq == string::npos ? "" : arg.substr(eq + 1);
+    if(name == "bitmap" && value.empty()){
+        format->features |= file_system::feature_bitmap;
+    }
+    else if(name == "groups"){
+        int count = value.empty() ? default_group_count : stoi(value);
+        if(count < 1)
+            throw invalid_argument("Group count should be a positive integer.");
+        format->features |= file_system::feature_groups;
+        format->group_count = count;
+    }
+    else if(name == "v2" && value.empty()){
+        format->features |= file_system::feature_v2;
+    }
+    else if(name == "extents" && value.empty()){
+        format->features |= file_system::feature_extents | file_system::feature_v2;
+    }
+    else if(name == "inline_data" && value.empty()){
+        format->features |= file_system::feature_inline_data | file_system::feature_v2;
+    }
+    else if(name == "dir_index" && value.empty()){
+        format->features |= file_system::feature_dir_index | file_system::feature_v2;
+    }
+    else if(name == "long_names" && value.empty()){
+        format->features |= file_system::feature_long_names | file_system::feature_v2;
+    }
+    else if(name == "sparse" && value.empty()){
+        format->features |= file_system::feature_sparse;
+    }
+    else if(name == "compress"){
+        int blocks = value.empty() ? default_cluster_blocks : stoi(value);
+        if(blocks < 2)
+            throw invalid_argument("A compression cluster should have at least 2 blocks.");
+        format->features |= file_system::feature_compress | file_system::feature_v2;
+        format->cluster_blocks = blocks;
+    }
+    else if(name == "dedup" && value.empty()){
+        format->features |= file_system::feature_dedup | file_system::feature_v2;
+    }
+    else if(name == "metadata_csum" && value.empty()){
+        format->features |= file_system::feature_metadata_csum | file_system::feature_v2;
+    }
+    else if(name == "data_csum" && value.empty()){
+        format->features |= file_system::feature_data_csum | file_system::feature_metadata_csum |
+                            file_system::feature_v2;
+    }
+    else if(name == "journal"){
+        int blocks = value.empty() ? 0 : stoi(value);
+        if(!value.empty() && blocks < (int) journal::min_blocks)
+            throw invalid_argument("Journal should have at least " + to_string(journal::min_blocks) + " blocks.");
+        format->features |= file_system::feature_journal | file_system::feature_v2;
+        format->journal_blocks = blocks;
+    }
+    else if(name == "size"){
+        format->features |= file_system::feature_v2;
+        format->image_size = parse_size(value);
+    }
+    else{
+        throw invalid_argument("Unknown file system feature: " + arg);
+    }
+}
+
+uint64_t args_reader::parse_size(const string &value) {
+    size_t end = 0;
+    long long size = value.empty() ? 0 : stoll(value, &end);
+    string unit = value.substr(end);
+    int shift = 0;
+    if(unit == "K")
+        shift = 10;
+    else if(unit == "M")
+        shift = 20;
+    else if(unit == "G")
+        shift = 30;
+    else if(!unit.empty())
+        throw invalid_argument("Image size should be a byte count with an optional K, M or G suffix.");
+    if(size < 1 || (uint64_t) size > (UINT64_MAX >> shift))
+        throw invalid_argument("Image size should be a positive integer.");
+    return (uint64_t) size << shift;
+}
+
+fs_options args_reader::session_options() {
+    fs_options opts;
+    const char * mode = getenv("FS_IO");
+    if(mode == nullptr || mode == string("pread"))
+        opts.mode = block_device::pread_mode;
+    else if(mode == string("mmap"))
+        opts.mode = block_device::mmap_mode;
+    else if(mode == string("uring"))
+        opts.mode = block_device::uring_mode;
+    else if(mode == string("thread"))
+        opts.mode = block_device::thread_mode;
+    else
+        throw invalid_argument("FS_IO should be one of pread, mmap, uring or thread.");
+    const char * cache_blocks = getenv("FS_CACHE_BLOCKS");
+    if(cache_blocks != nullptr){
+        int blocks = stoi(cache_blocks);
+        if(blocks < 1)
+            throw invalid_argument("FS_CACHE_BLOCKS should be a positive integer.");
+        opts.cache_blocks = blocks;
+    }
+    const char * commit = getenv("FS_COMMIT");
+    if(commit != nullptr){
+        int interval = stoi(commit);
+        if(interval < 1)
+            throw invalid_argument("FS_COMMIT should be a positive integer.");
+        opts.commit_interval = interval;
+    }
+    return opts;
+}
+
 void args_reader::file_oper(int argc, const char **argv) {
     const char * filename = argv[1];
     if(argc < 3)
         throw invalid_argument("Please check your arguments.");
+    fs_options opts = session_options();
     if(argv[2] == string("list")){
         if(argc != 4)
             throw invalid_argument("list only needs one argument.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.list_folders(argv[3]);
     }
     else if (argv[2] == string("mkdir")){
         if(argc != 4)
             throw invalid_argument("mkdir only needs one argument.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.mkdir(argv[3]);
     }
     else if (argv[2] == string("rmdir")){
         if(argc != 4)
             throw invalid_argument("rmdir only needs one argument.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.rmdir(argv[3]);
     }
     else if (argv[2] == string("dumpe2fs")){
         if(argc != 3)
             throw invalid_argument("No arguments are required with dump2fs.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.dumpe2fs();
     }
     else if (argv[2] == string("write")){
         if(argc != 5)
             throw invalid_argument("write needs 2 arguments.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.copy_file(argv[3],argv[4]);
     }
     else if (argv[2] == string("read")){
         if(argc != 5)
             throw invalid_argument("read needs 2 arguments.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.read_file(argv[3],argv[4]);
     }
     else if (argv[2] == string("ln")){
         if(argc != 5)
             throw invalid_argument("ln needs 2 arguments.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.hard_link(argv[3],argv[4]);
     }
     else if (argv[2] == string("lnsym")){
         if(argc != 5)
             throw invalid_argument("lnsym needs 2 arguments.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.soft_link(argv[3],argv[4]);
     }
     else if (argv[2] == string("fsck")){
         if(argc != 3)
             throw invalid_argument("No arguments are required with fsck.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.fsck();
     }else if (argv[2] == string("del")){
         if(argc != 4)
             throw invalid_argument("rmdir only needs one argument.");
-        file_system fs(filename);
+        file_system fs(filename, opts);
         fs.del(argv[3]);
     }
+    else if (argv[2] == string("punch")){
+        if(argc != 6)
+            throw invalid_argument("punch needs 3 arguments.");
+        file_system fs(filename, opts);
+        fs.punch(argv[3],stoull(argv[4]),stoull(argv[5]));
+    }
+    else if (argv[2] == string("scrub")){
+        if(argc != 3)
+            throw invalid_argument("No arguments are required with scrub.");
+        // damaged metadata is reported instead of stopping the command
+        opts.check_metadata = false;
+        file_system fs(filename, opts);
+        fs.scrub();
+    }
     else{
         throw invalid_argument("Unrecognized command.");
     }
@@ -5,13 +5,22 @@
 #ifndef OS_MIDTERM_ARGS_READER_H
 #define OS_MIDTERM_ARGS_READER_H
 
+#include "file_system.h"
 
 class args_reader {
 public:
-    static void mfs(int argc, const char **argv, int *bs, int *ic);
+    static void mfs(int argc, const char **argv, int *bs, int *ic, format_options *format);
     static void file_oper(int argc,const char ** argv);
 private:
     args_reader() = default;
+    // backend and cache size selected with environment variables
+    static fs_options session_options();
+    // format feature given after the file name of makeFileSystem
+    static void parse_feature(const std::string& arg, format_options *format);
+    // image size like 4096, 512K, 64M or 2G in bytes
+    static uint64_t parse_size(const std::string& value);
+    static const int default_group_count = 4;
+    static const int default_cluster_blocks = 4;
     static const int argc_no = 4;
 
 
@@ -0,0 +1,202 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "async_io.h"
+
+using namespace std;
+
+static int sys_io_uring_setup(unsigned entries, io_uring_params *p) {
+    return (int) syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int) syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+ssize_t transfer_run(int fd, const io_run &run, size_t done, bool write) {
+    vector<iovec> iov(run.iov);
+    // skip the part that is already transferred
+    size_t first = 0, skip = done;
+    while (first < iov.size() && skip >= iov[first].iov_len)
+        skip -= iov[first++].iov_len;
+    while (done < run.len) {
+        iov[first].iov_base = (char *) iov[first].iov_base + skip;
+        iov[first].iov_len -= skip;
+        ssize_t r = write ? pwritev(fd, &iov[first], (int) (iov.size() - first), run.off + done)
+                          : preadv(fd, &iov[first], (int) (iov.size() - first), run.off + done);
+        if (r < 0 && errno == EINTR) {
+            skip = 0;
+            continue;
+        }
+        if (r < 0)
+            return -errno;
+        if (r == 0)
+            break;
+        done += r;
+        skip = r;
+        while (first < iov.size() && skip >= iov[first].iov_len)
+            skip -= iov[first++].iov_len;
+    }
+    return (ssize_t) done;
+}
+
+io_ring::~io_ring() {
+    if (sqes_ptr != nullptr)
+        munmap(sqes_ptr, sqes_size);
+    if (cq_ptr != nullptr && cq_ptr != sq_ptr)
+        munmap(cq_ptr, cq_size);
+    if (sq_ptr != nullptr)
+        munmap(sq_ptr, sq_size);
+    if (ring_fd >= 0)
+        close(ring_fd);
+}
+
+bool io_ring::setup(unsigned entries) {
+    io_uring_params p{};
+    ring_fd = sys_io_uring_setup(entries, &p);
+    if (ring_fd < 0)
+        return false;
+    sq_entries = p.sq_entries;
+    sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+        sq_size = cq_size = max(sq_size, cq_size);
+    sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED) {
+        sq_ptr = nullptr;
+        return false;
+    }
+    if (single_mmap) {
+        cq_ptr = sq_ptr;
+    }
+    else {
+        cq_ptr = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED) {
+            cq_ptr = nullptr;
+            return false;
+        }
+    }
+    sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) {
+        sqes_ptr = nullptr;
+        return false;
+    }
+    char* sq = (char *) sq_ptr;
+    char* cq = (char *) cq_ptr;
+    sq_head = (unsigned *) (sq + p.sq_off.head);
+    sq_tail = (unsigned *) (sq + p.sq_off.tail);
+    sq_mask = (unsigned *) (sq + p.sq_off.ring_mask);
+    sq_array = (unsigned *) (sq + p.sq_off.array);
+    cq_head = (unsigned *) (cq + p.cq_off.head);
+    cq_tail = (unsigned *) (cq + p.cq_off.tail);
+    cq_mask = (unsigned *) (cq + p.cq_off.ring_mask);
+    cqes = cq + p.cq_off.cqes;
+    return true;
+}
+
+void io_ring::run(int fd, const vector<io_run> &runs, bool write, vector<ssize_t> &results) {
+    results.assign(runs.size(), 0);
+    auto* sqes = (io_uring_sqe *) sqes_ptr;
+    auto* cqe_arr = (io_uring_cqe *) cqes;
+    size_t next = 0, done = 0, in_flight = 0;
+    while (done < runs.size()) {
+        // fill the submission queue as much as possible
+        unsigned tail = *sq_tail;
+        unsigned to_submit = 0;
+        while (next < runs.size() && in_flight < sq_entries) {
+            unsigned index = tail & *sq_mask;
+            io_uring_sqe* sqe = &sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+            sqe->fd = fd;
+            sqe->addr = (unsigned long) runs[next].iov.data();
+            sqe->len = (unsigned) runs[next].iov.size();
+            sqe->off = runs[next].off;
+            sqe->user_data = next;
+            sq_array[index] = index;
+            tail++;
+            next++;
+            to_submit++;
+            in_flight++;
+        }
+        __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+        int r = sys_io_uring_enter(ring_fd, to_submit, 1, IORING_ENTER_GETEVENTS);
+        if (r < 0 && errno != EINTR)
+            throw runtime_error("Couldn't submit the I/O batch.");
+        // reap every completion that is ready
+        unsigned head = *cq_head;
+        while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe* cqe = &cqe_arr[head & *cq_mask];
+            results[cqe->user_data] = cqe->res;
+            head++;
+            done++;
+            in_flight--;
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+    }
+    // short transfers are finished synchronously
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (results[i] >= 0 && (size_t) results[i] < runs[i].len)
+            results[i] = transfer_run(fd, runs[i], results[i], write);
+    }
+}
+
+io_thread_pool::io_thread_pool(size_t thread_count) {
+    for (size_t i = 0; i < thread_count; ++i)
+        workers.emplace_back(&io_thread_pool::worker, this);
+}
+
+io_thread_pool::~io_thread_pool() {
+    {
+        lock_guard<mutex> lock(m);
+        stop = true;
+    }
+    work_cv.notify_all();
+    for (auto& t : workers)
+        t.join();
+}
+
+void io_thread_pool::run(int fd, const vector<io_run> &runs, bool write, vector<ssize_t> &results) {
+    results.assign(runs.size(), 0);
+    if (runs.empty())
+        return;
+    unique_lock<mutex> lock(m);
+    jobs = &runs;
+    job_results = &results;
+    job_fd = fd;
+    job_write = write;
+    next_job = 0;
+    finished = 0;
+    work_cv.notify_all();
+    done_cv.wait(lock, [this] { return finished == jobs->size(); });
+    jobs = nullptr;
+    job_results = nullptr;
+}
+
+void io_thread_pool::worker() {
+    unique_lock<mutex> lock(m);
+    while (true) {
+        work_cv.wait(lock, [this] { return stop || (jobs != nullptr && next_job < jobs->size()); });
+        if (stop)
+            return;
+        size_t index = next_job++;
+        const io_run& run = (*jobs)[index];
+        int fd = job_fd;
+        bool write = job_write;
+        lock.unlock();
+        ssize_t r = transfer_run(fd, run, 0, write);
+        lock.lock();
+        (*job_results)[index] = r;
+        if (++finished == jobs->size())
+            done_cv.notify_one();
+    }
+}
@@ -0,0 +1,90 @@
+#ifndef OS_MIDTERM_ASYNC_IO_H
+#define OS_MIDTERM_ASYNC_IO_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+
+// one whole block transfer of a batch
+struct block_io {
+    size_t bno;
+    char* buf;
+};
+
+// physically contiguous blocks transferred with one vectored call
+struct io_run {
+    size_t off;
+    size_t len;
+    std::vector<iovec> iov;
+};
+
+// whole vectored transfer with preadv/pwritev, returns the byte count or -errno
+ssize_t transfer_run(int fd, const io_run& run, size_t done, bool write);
+
+/* Minimal io_uring without liburing. A batch is submitted as a whole
+ * and all of its completions are reaped before returning. */
+class io_ring {
+public:
+    io_ring() = default;
+    ~io_ring();
+    io_ring(const io_ring&) = delete;
+    io_ring& operator=(const io_ring&) = delete;
+
+    // returns false when the kernel doesn't support io_uring
+    bool setup(unsigned entries);
+    // results[i] is the byte count or -errno of runs[i]
+    void run(int fd, const std::vector<io_run>& runs, bool write, std::vector<ssize_t>& results);
+
+private:
+    int ring_fd = -1;
+    unsigned sq_entries = 0;
+    void* sq_ptr = nullptr;
+    size_t sq_size = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_size = 0;
+    void* sqes_ptr = nullptr;
+    size_t sqes_size = 0;
+
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    void* cqes = nullptr;
+};
+
+/* Fallback when io_uring is unavailable, workers share the
+ * runs of a batch and the caller waits for all of them. */
+class io_thread_pool {
+public:
+    explicit io_thread_pool(size_t thread_count);
+    ~io_thread_pool();
+    io_thread_pool(const io_thread_pool&) = delete;
+    io_thread_pool& operator=(const io_thread_pool&) = delete;
+
+    void run(int fd, const std::vector<io_run>& runs, bool write, std::vector<ssize_t>& results);
+
+private:
+    void worker();
+
+    std::vector<std::thread> workers;
+    std::mutex m;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+    // current batch
+    const std::vector<io_run>* jobs = nullptr;
+    std::vector<ssize_t>* job_results = nullptr;
+    int job_fd = -1;
+    bool job_write = false;
+    size_t next_job = 0;
+    size_t finished = 0;
+    bool stop = false;
+};
+
+
+#endif //OS_MIDTERM_ASYNC_IO_H
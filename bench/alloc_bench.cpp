@@ -0,0 +1,112 @@
+// Heap allocations made by the file system while a 1 MiB file is read and
+// written, counted by replacing the global operator new. Features are given
+// like makeFileSystem.
+// usage: allocBench [block size KB] [features...]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "args_reader.h"
+#include "file_system.h"
+
+using namespace std;
+
+static atomic<size_t> alloc_count(0);
+static atomic<size_t> alloc_bytes(0);
+
+void* operator new(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw bad_alloc();
+    return p;
+}
+
+// not inlined, the compiler would see the pointers of new given to free
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+static const size_t file_size = 1 << 20;
+static const char* image = "/tmp/allocBench.img";
+static const char* in_file = "/tmp/allocBench.in";
+static const char* out_file = "/tmp/allocBench.out";
+
+struct counts {
+    size_t allocs;
+    size_t bytes;
+    double ms;
+};
+
+template <typename F>
+static counts count_of(F f) {
+    size_t a = alloc_count, b = alloc_bytes;
+    auto start = chrono::steady_clock::now();
+    f();
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return counts{alloc_count - a, alloc_bytes - b, ms};
+}
+
+// blocks of the file
+static size_t block_count = 0;
+
+static void print(const char* name, const counts& c) {
+    printf("%-12s %10zu %12zu %10.2f %10.2f\n", name, c.allocs, c.bytes, (double) c.allocs / block_count, c.ms);
+}
+
+int main(int argc, const char** argv) {
+    try {
+        string bs = argc > 1 ? argv[1] : "1";
+        // image of 16 MB so that the file fits with every block size
+        vector<const char*> mfs_args{"allocBench", bs.c_str(), "64", image, "size=16M"};
+        for (int i = 2; i < argc; ++i)
+            mfs_args.push_back(argv[i]);
+        int block_kb, inode_count;
+        format_options format;
+        args_reader::mfs((int) mfs_args.size(), mfs_args.data(), &block_kb, &inode_count, &format);
+        block_count = file_size / ((size_t) block_kb << 10);
+        {
+            file_system fs(block_kb, inode_count, format);
+            fs.create_file(image);
+        }
+        // random contents so that no feature stores less than the whole file
+        vector<char> data(file_size);
+        uint32_t state = 1;
+        for (auto& c : data) {
+            state = state * 1664525u + 1013904223u;
+            c = (char) (state >> 24);
+        }
+        ofstream(in_file, ios::binary).write(data.data(), data.size());
+
+        printf("%-12s %10s %12s %10s %10s\n", "1 MiB", "allocs", "bytes", "per block", "ms");
+        print("write", count_of([]() {
+            file_system fs(image);
+            fs.copy_file("/file", in_file);
+        }));
+        {
+            // the file system is opened before counting, the read is counted cold and warm
+            file_system fs(image);
+            print("read cold", count_of([&]() { fs.read_file("/file", out_file); }));
+            print("read warm", count_of([&]() { fs.read_file("/file", out_file); }));
+        }
+        remove(image);
+        remove(in_file);
+        remove(out_file);
+    }
+    catch (exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
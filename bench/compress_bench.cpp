@@ -0,0 +1,141 @@
+// Throughput and ratio of the cluster compression for some kinds of data
+// and cluster sizes. A file given as an argument is measured too.
+// usage: compressBench [block size KB] [file]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "lz4_codec.h"
+
+using namespace std;
+
+struct data_set {
+    string name;
+    vector<char> bytes;
+};
+
+static const size_t data_size = 8 << 20;
+static const size_t cluster_header = 4;
+
+static uint32_t next_random(uint32_t& state) {
+    state = state * 1664525u + 1013904223u;
+    return state >> 8;
+}
+
+static vector<data_set> make_data_sets() {
+    vector<data_set> res;
+    uint32_t state = 1;
+    res.push_back({"zeros", vector<char>(data_size, 0)});
+
+    static const char* words[] = {"the", "file", "system", "block", "inode", "directory",
+                                  "cluster", "write", "read", "free", "list", "of", "a", "and"};
+    data_set text{"text", {}};
+    while (text.bytes.size() < data_size) {
+        string w = words[next_random(state) % (sizeof(words) / sizeof(words[0]))];
+        text.bytes.insert(text.bytes.end(), w.begin(), w.end());
+        text.bytes.push_back(next_random(state) % 12 == 0 ? '\n' : ' ');
+    }
+    text.bytes.resize(data_size);
+    res.push_back(text);
+
+    // records of a counter, a small value and padding like a table of a program
+    data_set records{"records", vector<char>(data_size, 0)};
+    for (size_t i = 0; i + 16 <= data_size; i += 16) {
+        uint32_t id = i / 16, value = next_random(state) % 100;
+        memcpy(&records.bytes[i], &id, 4);
+        memcpy(&records.bytes[i + 4], &value, 4);
+    }
+    res.push_back(records);
+
+    data_set random{"random", vector<char>(data_size)};
+    for (auto& c : random.bytes)
+        c = (char) next_random(state);
+    res.push_back(random);
+    return res;
+}
+
+template <typename F>
+static double seconds_of(F f, size_t& rounds) {
+    // repeated until the measurement is long enough
+    rounds = 0;
+    auto start = chrono::steady_clock::now();
+    double elapsed = 0;
+    while (elapsed < 0.3) {
+        f();
+        rounds++;
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+    return elapsed / rounds;
+}
+
+static void measure(const data_set& d, size_t block_size, size_t cluster_blocks) {
+    size_t cluster = block_size * cluster_blocks;
+    size_t count = d.bytes.size() / cluster;
+    if (count == 0)
+        return;
+    vector<char> packed(count * cluster);
+    vector<size_t> lens(count);
+    size_t rounds = 0;
+    double comp = seconds_of([&]() {
+        for (size_t c = 0; c < count; ++c)
+            lens[c] = lz4_codec::compress(&d.bytes[c * cluster], cluster, &packed[c * cluster],
+                                          (cluster_blocks - 1) * block_size - cluster_header);
+    }, rounds);
+    // blocks taken as the file system stores them
+    size_t blocks = 0, stored = 0;
+    for (auto len : lens) {
+        if (len == 0)
+            stored++;
+        blocks += len == 0 ? cluster_blocks : (cluster_header + len + block_size - 1) / block_size;
+    }
+    vector<char> out(cluster);
+    double decomp = seconds_of([&]() {
+        for (size_t c = 0; c < count; ++c) {
+            if (lens[c] != 0)
+                lz4_codec::decompress(&packed[c * cluster], lens[c], out.data(), cluster);
+        }
+    }, rounds);
+    for (size_t c = 0; c < count; ++c) {
+        if (lens[c] == 0)
+            continue;
+        size_t n = lz4_codec::decompress(&packed[c * cluster], lens[c], out.data(), cluster);
+        if (n != cluster || memcmp(out.data(), &d.bytes[c * cluster], cluster) != 0)
+            throw logic_error("Round trip of " + d.name + " failed.");
+    }
+    double mb = (double) count * cluster / (1 << 20);
+    printf("%-10s %8zu %7.2f %9zu %10.1f ", d.name.c_str(), cluster / 1024,
+           (double) count * cluster_blocks / blocks, stored, mb / comp);
+    // stored clusters aren't decompressed
+    if (stored == count)
+        printf("%10s\n", "-");
+    else
+        printf("%10.1f\n", mb * (count - stored) / count / decomp);
+}
+
+int main(int argc, const char** argv) {
+    try {
+        size_t block_size = (argc > 1 ? stoul(argv[1]) : 4) * 1024;
+        vector<data_set> sets = make_data_sets();
+        if (argc > 2) {
+            ifstream file(argv[2], ios::binary);
+            file.exceptions(std::ios::failbit | std::ios::badbit);
+            sets.push_back({argv[2], vector<char>(istreambuf_iterator<char>(file), istreambuf_iterator<char>())});
+        }
+        printf("%-10s %8s %7s %9s %10s %10s\n", "data", "cluster", "ratio", "stored", "comp MB/s", "dec MB/s");
+        for (auto& d : sets) {
+            for (size_t cluster_blocks = 2; cluster_blocks <= 16; cluster_blocks *= 2)
+                measure(d, block_size, cluster_blocks);
+        }
+    }
+    catch (exception& e) {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,186 @@
+#include <cstring>
+#include <stdexcept>
+#include "block_bitmap.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+const size_t block_bitmap::npos;
+
+static const size_t word_bits = 64;
+
+// index of the first word in [from, to) that is not equal to pattern
+static size_t skip_words_scalar(const uint64_t* w, size_t from, size_t to, uint64_t pattern) {
+    while (from < to && w[from] == pattern)
+        from++;
+    return from;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static size_t skip_words_avx2(const uint64_t* w, size_t from, size_t to, uint64_t pattern) {
+    __m256i p = _mm256_set1_epi64x((long long) pattern);
+    // four words are compared at once until one of them differs
+    while (from + 4 <= to) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (w + from));
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, p)) != -1)
+            break;
+        from += 4;
+    }
+    return skip_words_scalar(w, from, to, pattern);
+}
+
+static size_t (*pick_skip_words())(const uint64_t*, size_t, size_t, uint64_t) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? skip_words_avx2 : skip_words_scalar;
+}
+#else
+static size_t (*pick_skip_words())(const uint64_t*, size_t, size_t, uint64_t) {
+    return skip_words_scalar;
+}
+#endif
+
+// chosen once by the cpu features
+static size_t (*const skip_words)(const uint64_t*, size_t, size_t, uint64_t) = pick_skip_words();
+
+void block_bitmap::reset(size_t bits, size_t block_bits) {
+    if (block_bits == 0 || block_bits % word_bits != 0)
+        throw invalid_argument("Bitmap block size should be a multiple of 64 bits.");
+    bit_count = bits;
+    bits_per_block = block_bits;
+    size_t blocks = (bit_count + bits_per_block - 1) / bits_per_block;
+    words.assign(blocks * bits_per_block / word_bits, 0);
+    dirty.assign(blocks, true);
+    // bits after the last block are never free
+    for (size_t i = bit_count; i < blocks * bits_per_block; ++i)
+        words[i / word_bits] |= (uint64_t) 1 << (i % word_bits);
+}
+
+void block_bitmap::load(const char *bytes) {
+    vector<uint64_t> pad(words);
+    memcpy(words.data(), bytes, words.size() * sizeof(uint64_t));
+    for (size_t i = bit_count / word_bits; i < words.size(); ++i)
+        words[i] |= pad[i];
+    dirty.assign(dirty.size(), false);
+}
+
+size_t block_bitmap::size() const {
+    return bit_count;
+}
+
+size_t block_bitmap::block_count() const {
+    return dirty.size();
+}
+
+bool block_bitmap::test(size_t bit) const {
+    if (bit >= bit_count)
+        throw out_of_range("Block is out of the bitmap.");
+    return (words[bit / word_bits] >> (bit % word_bits)) & 1;
+}
+
+void block_bitmap::set(size_t bit) {
+    if (bit >= bit_count)
+        throw out_of_range("Block is out of the bitmap.");
+    words[bit / word_bits] |= (uint64_t) 1 << (bit % word_bits);
+    mark_dirty(bit);
+}
+
+void block_bitmap::clear(size_t bit) {
+    if (bit >= bit_count)
+        throw out_of_range("Block is out of the bitmap.");
+    words[bit / word_bits] &= ~((uint64_t) 1 << (bit % word_bits));
+    mark_dirty(bit);
+}
+
+size_t block_bitmap::count_free() const {
+    size_t used = 0;
+    for (auto w : words)
+        used += __builtin_popcountll(w);
+    return words.size() * word_bits - used;
+}
+
+size_t block_bitmap::find_free(size_t hint) const {
+    if (hint >= bit_count)
+        hint = 0;
+    size_t res = scan(hint, bit_count, true);
+    if (res == npos)
+        res = scan(0, hint, true);
+    return res;
+}
+
+size_t block_bitmap::find_free_run(size_t count, size_t hint) const {
+    if (count == 0 || count > bit_count)
+        return npos;
+    if (hint >= bit_count)
+        hint = 0;
+    // a run doesn't wrap around the end of the bitmap
+    size_t res = find_run_in(count, hint, bit_count);
+    if (res == npos)
+        res = find_run_in(count, 0, min(hint + count - 1, bit_count));
+    return res;
+}
+
+void block_bitmap::get_free_bits(vector<size_t> &res) const {
+    size_t bit = scan(0, bit_count, true);
+    while (bit != npos) {
+        size_t end = scan(bit, bit_count, false);
+        if (end == npos)
+            end = bit_count;
+        for (; bit < end; ++bit)
+            res.push_back(bit);
+        bit = scan(end, bit_count, true);
+    }
+}
+
+const char *block_bitmap::block_bytes(size_t i) const {
+    return (const char *) words.data() + i * bits_per_block / 8;
+}
+
+size_t block_bitmap::bytes_per_block() const {
+    return bits_per_block / 8;
+}
+
+bool block_bitmap::is_dirty(size_t i) const {
+    return dirty[i];
+}
+
+void block_bitmap::clean(size_t i) {
+    dirty[i] = false;
+}
+
+size_t block_bitmap::scan(size_t from, size_t to, bool free) const {
+    if (from >= to)
+        return npos;
+    // free bits are searched as set bits of the inverted words
+    uint64_t skip = free ? ~(uint64_t) 0 : 0;
+    size_t last = (to - 1) / word_bits;
+    size_t w = from / word_bits;
+    uint64_t cur = (words[w] ^ skip) & (~(uint64_t) 0 << (from % word_bits));
+    while (cur == 0) {
+        w = skip_words(words.data(), w + 1, last + 1, skip);
+        if (w > last)
+            return npos;
+        cur = words[w] ^ skip;
+    }
+    size_t bit = w * word_bits + __builtin_ctzll(cur);
+    return bit < to ? bit : npos;
+}
+
+size_t block_bitmap::find_run_in(size_t count, size_t from, size_t to) const {
+    while (from < to) {
+        size_t start = scan(from, to, true);
+        if (start == npos || to - start < count)
+            return npos;
+        size_t end = scan(start, start + count, false);
+        if (end == npos)
+            return start;
+        from = end + 1;
+    }
+    return npos;
+}
+
+void block_bitmap::mark_dirty(size_t bit) {
+    dirty[bit / bits_per_block] = true;
+}
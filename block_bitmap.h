@@ -0,0 +1,51 @@
+#ifndef OS_MIDTERM_BLOCK_BITMAP_H
+#define OS_MIDTERM_BLOCK_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* In memory copy of the on disk block bitmap, bit i is set when block i
+ * is in use. Searches skip whole 64 bit words (four at a time with AVX2)
+ * and the bitmap blocks changed since the last flush are tracked. */
+class block_bitmap {
+public:
+    static const size_t npos = (size_t) -1;
+
+    // every bit is free, bits_per_block is the bit count of one bitmap block
+    void reset(size_t bit_count, size_t bits_per_block);
+    // replaces the contents with the bytes of the bitmap blocks
+    void load(const char* bytes);
+
+    size_t size() const;
+    size_t block_count() const;
+    bool test(size_t bit) const;
+    void set(size_t bit);
+    void clear(size_t bit);
+    size_t count_free() const;
+    // first free bit at or after hint, wraps around to the beginning
+    size_t find_free(size_t hint) const;
+    // first of count consecutive free bits at or after hint, wraps around
+    size_t find_free_run(size_t count, size_t hint) const;
+    void get_free_bits(std::vector<size_t>& res) const;
+
+    // bytes of the i'th bitmap block
+    const char* block_bytes(size_t i) const;
+    size_t bytes_per_block() const;
+    bool is_dirty(size_t i) const;
+    void clean(size_t i);
+
+private:
+    // first bit in [from, to) that is free or used
+    size_t scan(size_t from, size_t to, bool free) const;
+    size_t find_run_in(size_t count, size_t from, size_t to) const;
+    void mark_dirty(size_t bit);
+
+    std::vector<uint64_t> words;
+    std::vector<bool> dirty;
+    size_t bit_count = 0;
+    size_t bits_per_block = 0;
+};
+
+
+#endif //OS_MIDTERM_BLOCK_BITMAP_H
@@ -0,0 +1,324 @@
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "block_device.h"
+
+using namespace std;
+
+block_device::~block_device() {
+    close();
+}
+
+void block_device::open(const char *filename, io_mode m) {
+    close();
+    fd = ::open(filename, O_RDWR);
+    if (fd < 0)
+        throw runtime_error("Couldn't open the file system image.");
+    open_count++;
+    mode = m;
+    if (mode == mmap_mode) {
+        struct stat st{};
+        if (fstat(fd, &st) < 0)
+            throw runtime_error("Couldn't get the size of the file system image.");
+        map_size = st.st_size;
+        void* addr = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED)
+            throw runtime_error("Couldn't map the file system image.");
+        map = (char *) addr;
+    }
+    else if (mode == uring_mode) {
+        ring.reset(new io_ring());
+        if (!ring->setup(ring_entries)) {
+            ring.reset();
+            mode = thread_mode;
+        }
+    }
+    if (mode == thread_mode)
+        pool.reset(new io_thread_pool(pool_threads));
+}
+
+void block_device::create(const char *filename) {
+    close();
+    fd = ::open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        throw runtime_error("Couldn't create the file system image.");
+    open_count++;
+}
+
+void block_device::truncate(size_t len) {
+    if (ftruncate(fd, (off_t) len) != 0)
+        throw runtime_error("Couldn't resize the file system image.");
+}
+
+void block_device::close() {
+    if (map != nullptr)
+        munmap(map, map_size);
+    map = nullptr;
+    map_size = 0;
+    ring.reset();
+    pool.reset();
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+}
+
+void block_device::set_block_size(size_t bs) {
+    block_size = bs;
+}
+
+void block_device::read_block(size_t bno, char *buf) {
+    read_at(bno * block_size, buf, block_size);
+}
+
+void block_device::write_block(size_t bno, const char *buf) {
+    write_at(bno * block_size, buf, block_size);
+}
+
+void block_device::read_at(size_t off, char *buf, size_t len) {
+    if (remaps.empty()) {
+        read_range(off, buf, len);
+        return;
+    }
+    // the parts between the remapped blocks of the range are read in one piece
+    size_t end = off + len;
+    size_t done = off;
+    auto it = remaps.lower_bound(off / block_size);
+    for (; it != remaps.end() && it->first * block_size < end; ++it) {
+        size_t from = max(done, it->first * block_size);
+        size_t to = min(end, (it->first + 1) * block_size);
+        if (done < from)
+            read_range(done, buf + (done - off), from - done);
+        read_range(it->second * block_size + from % block_size, buf + (from - off), to - from);
+        done = to;
+    }
+    if (done < end)
+        read_range(done, buf + (done - off), end - done);
+}
+
+void block_device::write_at(size_t off, const char *buf, size_t len) {
+    // the written blocks are up to date in their places again
+    if (!remaps.empty()) {
+        size_t last = (off + len + block_size - 1) / block_size;
+        remaps.erase(remaps.lower_bound(off / block_size), remaps.lower_bound(last));
+    }
+    write_range(off, buf, len);
+}
+
+void block_device::read_range(size_t off, char *buf, size_t len) {
+    if (mode == mmap_mode) {
+        if (off + len > map_size)
+            throw length_error("Read is beyond the end of the file system image.");
+        memcpy(buf, map + off, len);
+        read_bytes += len;
+        return;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pread(fd, buf + done, len - done, off + done);
+        read_count++;
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            throw runtime_error("Couldn't read from the file system image.");
+        if (r == 0)
+            throw length_error("Read is beyond the end of the file system image.");
+        done += r;
+    }
+    read_bytes += len;
+}
+
+void block_device::write_range(size_t off, const char *buf, size_t len) {
+    if (mode == mmap_mode) {
+        if (off + len > map_size)
+            throw length_error("Write is beyond the end of the file system image.");
+        // writes always come from the cache copies, the mapping isn't modified in place
+        memcpy(map + off, buf, len);
+        write_bytes += len;
+        unsynced = true;
+        return;
+    }
+    size_t done = 0;
+    while (done < len) {
+        ssize_t r = pwrite(fd, buf + done, len - done, off + done);
+        write_count++;
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            throw runtime_error("Couldn't write to the file system image.");
+        done += r;
+    }
+    write_bytes += len;
+}
+
+void block_device::read_blocks(const vector<block_io> &reqs) {
+    if (remaps.empty()) {
+        run_batch(reqs, false);
+        return;
+    }
+    vector<block_io> copies(reqs);
+    for (auto& req : copies)
+        req.bno = remapped_offset(req.bno * block_size) / block_size;
+    run_batch(copies, false);
+}
+
+void block_device::write_blocks(const vector<block_io> &reqs) {
+    for (size_t i = 0; !remaps.empty() && i < reqs.size(); ++i)
+        remaps.erase(reqs[i].bno);
+    run_batch(reqs, true);
+}
+
+void block_device::run_batch(const vector<block_io> &reqs, bool write) {
+    if (reqs.empty())
+        return;
+    batch_count++;
+    batched_blocks += reqs.size();
+    if (mode == mmap_mode) {
+        for (const auto& req : reqs) {
+            if (write)
+                write_range(req.bno * block_size, req.buf, block_size);
+            else
+                read_range(req.bno * block_size, req.buf, block_size);
+        }
+        return;
+    }
+    vector<io_run> runs;
+    make_runs(reqs, runs);
+    run_count += runs.size();
+    vector<ssize_t> results;
+    if (mode == uring_mode) {
+        ring->run(fd, runs, write, results);
+    }
+    else if (mode == thread_mode) {
+        pool->run(fd, runs, write, results);
+    }
+    else {
+        results.resize(runs.size());
+        for (size_t i = 0; i < runs.size(); ++i)
+            results[i] = transfer_run(fd, runs[i], 0, write);
+    }
+    for (size_t i = 0; i < runs.size(); ++i) {
+        if (results[i] < 0) {
+            errno = (int) -results[i];
+            throw runtime_error(write ? "Couldn't write to the file system image."
+                                      : "Couldn't read from the file system image.");
+        }
+        if ((size_t) results[i] != runs[i].len)
+            throw length_error("Transfer is beyond the end of the file system image.");
+    }
+    if (write) {
+        write_count += runs.size();
+        write_bytes += reqs.size() * block_size;
+    }
+    else {
+        read_count += runs.size();
+        read_bytes += reqs.size() * block_size;
+    }
+}
+
+void block_device::make_runs(const vector<block_io> &reqs, vector<io_run> &runs) const {
+    vector<block_io> sorted(reqs);
+    // stable, the copies of a block stay in the order they were given
+    stable_sort(sorted.begin(), sorted.end(), [](const block_io& a, const block_io& b) { return a.bno < b.bno; });
+    size_t prev = 0;
+    for (const auto& req : sorted) {
+        bool extends = !runs.empty() && req.bno == prev + 1 && runs.back().iov.size() < IOV_MAX;
+        // a block written twice in a batch keeps its last copy
+        if (!runs.empty() && req.bno == prev) {
+            runs.back().iov.back().iov_base = req.buf;
+            continue;
+        }
+        if (!extends) {
+            runs.emplace_back();
+            runs.back().off = req.bno * block_size;
+            runs.back().len = 0;
+        }
+        runs.back().iov.push_back(iovec{req.buf, block_size});
+        runs.back().len += block_size;
+        prev = req.bno;
+    }
+}
+
+char *block_device::map_block(size_t bno) const {
+    if (map == nullptr || (bno + 1) * block_size > map_size)
+        return nullptr;
+    return map + remapped_offset(bno * block_size);
+}
+
+void block_device::will_need(const vector<size_t> &bnos) {
+    if (map == nullptr)
+        return;
+    vector<size_t> sorted(bnos);
+    for (auto& bno : sorted)
+        bno = remapped_offset(bno * block_size) / block_size;
+    sort(sorted.begin(), sorted.end());
+    auto page = (size_t) sysconf(_SC_PAGESIZE);
+    for (size_t i = 0; i < sorted.size();) {
+        size_t j = i + 1;
+        while (j < sorted.size() && sorted[j] == sorted[j - 1] + 1)
+            j++;
+        size_t start = sorted[i] * block_size;
+        size_t end = min((sorted[j - 1] + 1) * block_size, map_size);
+        size_t aligned = start - start % page;
+        if (start < end)
+            madvise(map + aligned, end - aligned, MADV_WILLNEED);
+        i = j;
+    }
+}
+
+void block_device::sync() {
+    if (map == nullptr || !unsynced)
+        return;
+    if (msync(map, map_size, MS_SYNC) < 0)
+        throw runtime_error("Couldn't sync the file system image.");
+    unsynced = false;
+    sync_count++;
+}
+
+void block_device::sync_all() {
+    if (map != nullptr && msync(map, map_size, MS_SYNC) < 0)
+        throw runtime_error("Couldn't sync the file system image.");
+    if (fdatasync(fd) < 0)
+        throw runtime_error("Couldn't sync the file system image.");
+    unsynced = false;
+    sync_count++;
+}
+
+void block_device::remap(size_t bno, size_t copy) {
+    remaps[bno] = copy;
+}
+
+void block_device::clear_remaps() {
+    remaps.clear();
+}
+
+bool block_device::is_remapped(size_t bno) const {
+    return !remaps.empty() && remaps.count(bno) != 0;
+}
+
+void block_device::get_remaps(vector<pair<size_t, size_t>> &res) const {
+    res.assign(remaps.begin(), remaps.end());
+}
+
+size_t block_device::remapped_offset(size_t off) const {
+    if (remaps.empty())
+        return off;
+    auto it = remaps.find(off / block_size);
+    return it == remaps.end() ? off : it->second * block_size + off % block_size;
+}
+
+void block_device::print_stats() const {
+    static const char* const mode_names[] = {"pread", "mmap", "uring", "thread"};
+    fprintf(stderr, "mode: %s opens: %zu reads: %zu (%zu bytes) writes: %zu (%zu bytes) syncs: %zu\n",
+            mode_names[mode], open_count, read_count, read_bytes,
+            write_count, write_bytes, sync_count);
+    fprintf(stderr, "batches: %zu (%zu blocks) runs: %zu average run length: %.2f\n",
+            batch_count, batched_blocks, run_count,
+            run_count == 0 ? 0.0 : (double) batched_blocks / (double) run_count);
+}
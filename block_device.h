@@ -0,0 +1,97 @@
+#ifndef OS_MIDTERM_BLOCK_DEVICE_H
+#define OS_MIDTERM_BLOCK_DEVICE_H
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "async_io.h"
+
+/* Keeps the image open for the whole session and does positioned
+ * reads and writes on a single descriptor. In mmap mode the whole image
+ * is mapped and blocks can be accessed in place. In uring mode batches
+ * are submitted to io_uring, or to a thread pool if it is unavailable.
+ * A block can be remapped to a copy elsewhere in the image, the journal
+ * keeps the latest copies of the blocks it logged this way. */
+class block_device {
+public:
+    enum io_mode { pread_mode, mmap_mode, uring_mode, thread_mode };
+
+    block_device() = default;
+    ~block_device();
+    block_device(const block_device&) = delete;
+    block_device& operator=(const block_device&) = delete;
+
+    // opens an existing image for reading and writing
+    void open(const char* filename, io_mode mode = pread_mode);
+    // creates (or truncates) an image
+    void create(const char* filename);
+    // sets the image size, the blocks that were never written read as zeros
+    void truncate(size_t len);
+    void close();
+    // block size is known only after the superblock is read
+    void set_block_size(size_t block_size);
+
+    void read_block(size_t bno, char* buf);
+    void write_block(size_t bno, const char* buf);
+    // raw positioned access for records smaller than a block
+    void read_at(size_t off, char* buf, size_t len);
+    void write_at(size_t off, const char* buf, size_t len);
+    // whole block transfers of a batch are issued together
+    void read_blocks(const std::vector<block_io>& reqs);
+    void write_blocks(const std::vector<block_io>& reqs);
+    // address of the block inside the mapping, nullptr if not mapped
+    char* map_block(size_t bno) const;
+    // tells the kernel that the mapped blocks will be read soon
+    void will_need(const std::vector<size_t>& bnos);
+    // makes the writes of the operation durable in mmap mode
+    void sync();
+    // makes every write so far durable in every mode
+    void sync_all();
+    // reads of bno are served from the block copy until bno is written again
+    void remap(size_t bno, size_t copy);
+    void clear_remaps();
+    bool is_remapped(size_t bno) const;
+    // (block, copy) pairs sorted by block number
+    void get_remaps(std::vector<std::pair<size_t, size_t>>& res) const;
+
+    void print_stats() const;
+
+private:
+    void read_range(size_t off, char* buf, size_t len);
+    void write_range(size_t off, const char* buf, size_t len);
+    void run_batch(const std::vector<block_io>& reqs, bool write);
+    // offset of the byte at off after remapping its block
+    size_t remapped_offset(size_t off) const;
+    // sorts the requests and merges physically contiguous blocks
+    void make_runs(const std::vector<block_io>& reqs, std::vector<io_run>& runs) const;
+
+    static const unsigned ring_entries = 64;
+    static const size_t pool_threads = 4;
+
+    int fd = -1;
+    size_t block_size = 0;
+    io_mode mode = pread_mode;
+    std::unique_ptr<io_ring> ring;
+    std::unique_ptr<io_thread_pool> pool;
+    char* map = nullptr;
+    size_t map_size = 0;
+    // the mapping has writes that aren't synced yet
+    bool unsynced = false;
+    // ordered to find the remapped blocks of a range
+    std::map<size_t, size_t> remaps;
+    // syscall counters
+    size_t open_count = 0;
+    size_t read_count = 0;
+    size_t write_count = 0;
+    size_t read_bytes = 0;
+    size_t write_bytes = 0;
+    size_t sync_count = 0;
+    size_t batch_count = 0;
+    size_t batched_blocks = 0;
+    size_t run_count = 0;
+};
+
+
+#endif //OS_MIDTERM_BLOCK_DEVICE_H
@@ -0,0 +1,83 @@
+#include <cstring>
+#include "block_hash.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+static const size_t lanes = 8;
+static const size_t stripe = lanes * 4;
+static const uint32_t prime32_1 = 2654435761u;
+static const uint32_t prime32_2 = 2246822519u;
+static const uint64_t prime64_1 = 11400714785074694791ull;
+static const uint64_t prime64_2 = 14029467366897019727ull;
+static const uint64_t prime64_3 = 1609587929392839161ull;
+
+static uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// lane i reads the i'th 4 bytes of every stripe, returns the bytes consumed
+static size_t stripes_scalar(const char* data, size_t len, uint32_t* acc) {
+    size_t pos = 0;
+    for (; pos + stripe <= len; pos += stripe) {
+        for (size_t i = 0; i < lanes; ++i) {
+            uint32_t v;
+            memcpy(&v, data + pos + 4 * i, 4);
+            acc[i] = rotl32(acc[i] + v * prime32_2, 13) * prime32_1;
+        }
+    }
+    return pos;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static size_t stripes_avx2(const char* data, size_t len, uint32_t* acc) {
+    __m256i a = _mm256_loadu_si256((const __m256i*) acc);
+    const __m256i p1 = _mm256_set1_epi32((int) prime32_1);
+    const __m256i p2 = _mm256_set1_epi32((int) prime32_2);
+    size_t pos = 0;
+    for (; pos + stripe <= len; pos += stripe) {
+        __m256i v = _mm256_loadu_si256((const __m256i*) (data + pos));
+        a = _mm256_add_epi32(a, _mm256_mullo_epi32(v, p2));
+        a = _mm256_or_si256(_mm256_slli_epi32(a, 13), _mm256_srli_epi32(a, 19));
+        a = _mm256_mullo_epi32(a, p1);
+    }
+    _mm256_storeu_si256((__m256i*) acc, a);
+    return pos;
+}
+
+static size_t (*pick_stripes())(const char*, size_t, uint32_t*) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? stripes_avx2 : stripes_scalar;
+}
+#else
+static size_t (*pick_stripes())(const char*, size_t, uint32_t*) {
+    return stripes_scalar;
+}
+#endif
+
+// chosen once by the cpu features
+static size_t (*const stripes)(const char*, size_t, uint32_t*) = pick_stripes();
+
+uint64_t block_hash::of(const char *data, size_t len) {
+    uint32_t acc[lanes];
+    for (size_t i = 0; i < lanes; ++i)
+        acc[i] = prime32_1 + prime32_2 * (uint32_t) (i + 1);
+    size_t pos = stripes(data, len, acc);
+    uint64_t h = len * prime64_3;
+    for (size_t i = 0; i < lanes; ++i)
+        h = rotl64(h ^ (acc[i] * prime64_2), 31) * prime64_1;
+    for (; pos < len; ++pos)
+        h = rotl64(h ^ ((uint8_t) data[pos] * prime64_3), 11) * prime64_1;
+    // every bit of the result depends on every lane
+    h ^= h >> 33;
+    h *= prime64_2;
+    h ^= h >> 29;
+    h *= prime64_3;
+    h ^= h >> 32;
+    return h;
+}
@@ -0,0 +1,21 @@
+#ifndef OS_MIDTERM_BLOCK_HASH_H
+#define OS_MIDTERM_BLOCK_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* 64 bit hash of the contents of a block. The data is read in stripes of
+ * 32 bytes by eight independent 32 bit lanes, so a stripe is a single step
+ * with AVX2, then the lanes and the bytes after the last stripe are mixed.
+ * Both paths give the same value. It isn't a cryptographic hash, equal
+ * hashes still have to be compared byte by byte. */
+class block_hash {
+public:
+    static uint64_t of(const char* data, size_t len);
+
+private:
+    block_hash() = default;
+};
+
+
+#endif //OS_MIDTERM_BLOCK_HASH_H
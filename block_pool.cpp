@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <stdexcept>
+#include "block_pool.h"
+
+using namespace std;
+
+block_pool::~block_pool() {
+    for (auto buf : free_list)
+        delete[] buf;
+}
+
+void block_pool::set_block_size(size_t bs) {
+    if (taken != 0)
+        throw logic_error("Block size of a pool with taken buffers cannot be changed.");
+    for (auto buf : free_list)
+        delete[] buf;
+    free_list.clear();
+    block_size = bs;
+}
+
+size_t block_pool::get_block_size() const {
+    return block_size;
+}
+
+char *block_pool::take() {
+    if (block_size == 0)
+        throw logic_error("Block size of the pool is not set.");
+    if (free_list.empty()) {
+        char* buf = new char[block_size];
+        allocations++;
+        taken++;
+        // every buffer fits the list, giving one back never allocates
+        if (free_list.capacity() < allocations)
+            free_list.reserve(2 * allocations);
+        return buf;
+    }
+    taken++;
+    reuses++;
+    char* buf = free_list.back();
+    free_list.pop_back();
+    return buf;
+}
+
+void block_pool::give(char *buf) noexcept {
+    taken--;
+    free_list.push_back(buf);
+}
+
+void block_pool::print_stats() const {
+    fprintf(stderr, "block pool: allocations: %zu reuses: %zu taken: %zu\n", allocations, reuses, taken);
+}
@@ -0,0 +1,37 @@
+#ifndef OS_MIDTERM_BLOCK_POOL_H
+#define OS_MIDTERM_BLOCK_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+/* Free list of the block sized buffers of a file system. A block made from
+ * the pool gives its buffer back when it is destroyed, so once the blocks of
+ * an operation have been allocated the cache and the temporary blocks reuse
+ * them instead of allocating a buffer for every block read or written. */
+class block_pool {
+public:
+    block_pool() = default;
+    ~block_pool();
+    block_pool(const block_pool&) = delete;
+    block_pool& operator=(const block_pool&) = delete;
+
+    // can't be changed while buffers are taken
+    void set_block_size(size_t block_size);
+    size_t get_block_size() const;
+    // buffer of block_size bytes, the contents are undefined
+    char* take();
+    void give(char* buf) noexcept;
+
+    void print_stats() const;
+
+private:
+    size_t block_size = 0;
+    std::vector<char*> free_list;
+    // buffers that are in blocks
+    size_t taken = 0;
+    size_t allocations = 0;
+    size_t reuses = 0;
+};
+
+
+#endif //OS_MIDTERM_BLOCK_POOL_H
@@ -0,0 +1,175 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include "buffer_cache.h"
+
+using namespace std;
+
+buffer_cache::buffer_cache(block_device &dev, block_pool &pool, size_t capacity) : dev(dev), pool(pool),
+                                                                                   capacity(capacity) {
+    if (capacity == 0)
+        throw invalid_argument("Buffer cache capacity should be at least one block.");
+}
+
+void buffer_cache::set_block_size(size_t bs) {
+    if (!blocks.empty())
+        throw logic_error("Block size of a non empty cache cannot be changed.");
+    block_size = bs;
+}
+
+void buffer_cache::set_capacity(size_t cap) {
+    if (cap == 0)
+        throw invalid_argument("Buffer cache capacity should be at least one block.");
+    capacity = cap;
+    while (blocks.size() > capacity && !lru.empty())
+        evict();
+    // the buckets are made once instead of while the cache fills up
+    blocks.reserve(capacity);
+}
+
+size_t buffer_cache::get_capacity() const {
+    return capacity;
+}
+
+const data_block &buffer_cache::get(size_t bno) {
+    auto it = blocks.find(bno);
+    if (it != blocks.end()) {
+        hits++;
+        touch(it->second);
+        return it->second.blk;
+    }
+    misses++;
+    entry& e = insert(bno);
+    dev.read_block(bno, e.blk.arr);
+    return e.blk;
+}
+
+const data_block *buffer_cache::find(size_t bno) {
+    auto it = blocks.find(bno);
+    if (it == blocks.end())
+        return nullptr;
+    hits++;
+    touch(it->second);
+    return &it->second.blk;
+}
+
+const data_block *buffer_cache::peek(size_t bno) {
+    auto it = blocks.find(bno);
+    if (it == blocks.end())
+        return nullptr;
+    hits++;
+    return &it->second.blk;
+}
+
+void buffer_cache::prefetch(const vector<size_t> &bnos) {
+    vector<block_io> batch;
+    for (auto bno : bnos) {
+        // blocks of this batch must not evict each other, logged blocks are never evicted
+        if (batch.size() + logged.size() + 1 >= capacity)
+            break;
+        if (blocks.count(bno) != 0)
+            continue;
+        entry& e = insert(bno);
+        batch.push_back(block_io{bno, e.blk.arr});
+    }
+    misses += batch.size();
+    dev.read_blocks(batch);
+}
+
+void buffer_cache::put(const data_block &b, bool log) {
+    auto it = blocks.find(b.bno);
+    entry& e = (it != blocks.end()) ? it->second : insert(b.bno);
+    if (it != blocks.end())
+        touch(e);
+    if (e.blk.arr != b.arr)
+        memcpy(e.blk.arr, b.arr, block_size);
+    e.dirty = true;
+    if (log && !e.logged) {
+        // can't be evicted until the journal takes it
+        e.logged = true;
+        logged.splice(logged.end(), lru, e.lru_pos);
+    }
+}
+
+void buffer_cache::flush() {
+    // every dirty block is written in one batch
+    vector<block_io> batch;
+    for (auto& pair : blocks) {
+        if (pair.second.dirty && !pair.second.logged)
+            batch.push_back(block_io{pair.first, pair.second.blk.arr});
+    }
+    dev.write_blocks(batch);
+    for (auto& req : batch)
+        blocks.at(req.bno).dirty = false;
+    write_backs += batch.size();
+}
+
+void buffer_cache::get_logged(vector<block_io> &res) const {
+    res.clear();
+    for (auto bno : logged)
+        res.push_back(block_io{bno, blocks.at(bno).blk.arr});
+    sort(res.begin(), res.end(), [](const block_io& a, const block_io& b) { return a.bno < b.bno; });
+}
+
+void buffer_cache::release_logged() {
+    for (auto bno : logged) {
+        entry& e = blocks.at(bno);
+        e.dirty = false;
+        e.logged = false;
+    }
+    write_backs += logged.size();
+    lru.splice(lru.begin(), logged);
+    while (blocks.size() > capacity)
+        evict();
+}
+
+void buffer_cache::clear() {
+    blocks.clear();
+    lru.clear();
+    logged.clear();
+}
+
+buffer_cache::entry &buffer_cache::insert(size_t bno) {
+    if (blocks.size() >= capacity)
+        evict();
+    if (spare.empty()) {
+        lru.push_front(bno);
+    }
+    else {
+        lru.splice(lru.begin(), spare, spare.begin());
+        lru.front() = bno;
+    }
+    data_block blk(pool);
+    blk.bno = bno;
+    blk.size = block_size;
+    entry& e = blocks.emplace(bno, entry{std::move(blk), false, false, lru.begin()}).first->second;
+    return e;
+}
+
+void buffer_cache::touch(entry &e) {
+    if (!e.logged)
+        lru.splice(lru.begin(), lru, e.lru_pos);
+}
+
+void buffer_cache::evict() {
+    // the cache grows past its capacity when every block is logged
+    if (lru.empty())
+        return;
+    size_t victim = lru.back();
+    entry& e = blocks.at(victim);
+    if (e.dirty) {
+        dev.write_block(victim, e.blk.arr);
+        write_backs++;
+    }
+    spare.splice(spare.begin(), lru, prev(lru.end()));
+    blocks.erase(victim);
+    evictions++;
+}
+
+void buffer_cache::print_stats() const {
+    fprintf(stderr, "cache: capacity: %zu hits: %zu misses: %zu evictions: %zu write backs: %zu\n",
+            capacity, hits, misses, evictions, write_backs);
+}
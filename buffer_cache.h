@@ -0,0 +1,78 @@
+#ifndef OS_MIDTERM_BUFFER_CACHE_H
+#define OS_MIDTERM_BUFFER_CACHE_H
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "block_device.h"
+#include "data_block.h"
+#include "block_pool.h"
+
+/* Bounded LRU cache of image blocks keyed by block number.
+ * Modified blocks stay in the cache and are written back when they
+ * are evicted or when the cache is flushed at the end of an operation.
+ * Modified blocks that go to the journal are never written back, they
+ * are kept outside of the LRU order until the journal takes them. */
+class buffer_cache {
+public:
+    // the blocks take their buffers from pool
+    buffer_cache(block_device& dev, block_pool& pool, size_t capacity);
+
+    void set_block_size(size_t block_size);
+    void set_capacity(size_t capacity);
+    size_t get_capacity() const;
+
+    // returns the cached block, reads it from the device on a miss
+    const data_block& get(size_t bno);
+    // returns the cached block or nullptr without touching the device
+    const data_block* find(size_t bno);
+    // same as find but doesn't make the block recently used, for blocks read once
+    const data_block* peek(size_t bno);
+    // reads the blocks that aren't cached in one batch
+    void prefetch(const std::vector<size_t>& bnos);
+    // stores the contents of the block and marks it dirty, logged for the journal
+    void put(const data_block& b, bool logged = false);
+    // writes back every dirty block that isn't logged
+    void flush();
+    // logged blocks sorted by block number, valid until the cache is changed
+    void get_logged(std::vector<block_io>& res) const;
+    // the logged blocks are clean after the journal wrote them
+    void release_logged();
+    // drops every block without writing them back
+    void clear();
+
+    void print_stats() const;
+
+private:
+    struct entry {
+        data_block blk;
+        bool dirty;
+        bool logged;
+        // in logged instead of lru while logged
+        std::list<size_t>::iterator lru_pos;
+    };
+
+    entry& insert(size_t bno);
+    void touch(entry& e);
+    void evict();
+
+    block_device& dev;
+    block_pool& pool;
+    size_t block_size = 0;
+    size_t capacity;
+    // front is the most recently used block
+    std::list<size_t> lru;
+    std::list<size_t> logged;
+    // nodes of evicted blocks, reused by the next blocks
+    std::list<size_t> spare;
+    std::unordered_map<size_t, entry> blocks;
+
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t write_backs = 0;
+};
+
+
+#endif //OS_MIDTERM_BUFFER_CACHE_H
@@ -0,0 +1,74 @@
+#include <cstring>
+#include "crc32c.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// reversed Castagnoli polynomial
+static const uint32_t poly = 0x82F63B78u;
+
+struct crc_tables {
+    // t[k][b] is the crc of byte b followed by k zero bytes
+    uint32_t t[8][256];
+
+    crc_tables() {
+        for (uint32_t b = 0; b < 256; ++b) {
+            uint32_t c = b;
+            for (int i = 0; i < 8; ++i)
+                c = (c >> 1) ^ (poly & (0u - (c & 1)));
+            t[0][b] = c;
+        }
+        for (size_t k = 1; k < 8; ++k) {
+            for (size_t b = 0; b < 256; ++b)
+                t[k][b] = (t[k - 1][b] >> 8) ^ t[0][t[k - 1][b] & 0xFF];
+        }
+    }
+};
+
+static const crc_tables tables;
+
+static uint32_t update_table(uint32_t crc, const char* data, size_t len) {
+    const uint8_t* p = (const uint8_t*) data;
+    // slicing by eight, the words are read in little endian order
+    for (; len >= 8; len -= 8, p += 8) {
+        uint32_t lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24));
+        crc = tables.t[7][lo & 0xFF] ^ tables.t[6][(lo >> 8) & 0xFF] ^
+              tables.t[5][(lo >> 16) & 0xFF] ^ tables.t[4][lo >> 24] ^
+              tables.t[3][p[4]] ^ tables.t[2][p[5]] ^ tables.t[1][p[6]] ^ tables.t[0][p[7]];
+    }
+    for (; len > 0; --len, ++p)
+        crc = (crc >> 8) ^ tables.t[0][(crc ^ *p) & 0xFF];
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t update_sse42(uint32_t crc, const char* data, size_t len) {
+    uint64_t c = crc;
+    for (; len >= 8; len -= 8, data += 8) {
+        uint64_t v;
+        memcpy(&v, data, 8);
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (uint32_t) c;
+    for (; len > 0; --len, ++data)
+        crc = _mm_crc32_u8(crc, (uint8_t) *data);
+    return crc;
+}
+
+static uint32_t (*pick_update())(uint32_t, const char*, size_t) {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") ? update_sse42 : update_table;
+}
+#else
+static uint32_t (*pick_update())(uint32_t, const char*, size_t) {
+    return update_table;
+}
+#endif
+
+// chosen once by the cpu features
+static uint32_t (*const update)(uint32_t, const char*, size_t) = pick_update();
+
+uint32_t crc32c::of(const char *data, size_t len, uint32_t crc) {
+    return ~update(~crc, data, len);
+}
@@ -0,0 +1,20 @@
+#ifndef OS_MIDTERM_CRC32C_H
+#define OS_MIDTERM_CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* CRC32C (Castagnoli) of a byte range. The crc32 instruction of SSE4.2
+ * is used when the CPU has it, otherwise eight bytes at a time are looked
+ * up in tables. Both give the same value. */
+class crc32c {
+public:
+    // crc is the value of the bytes before data, 0 starts a new one
+    static uint32_t of(const char* data, size_t len, uint32_t crc = 0);
+
+private:
+    crc32c() = default;
+};
+
+
+#endif //OS_MIDTERM_CRC32C_H
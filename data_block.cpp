@@ -0,0 +1,175 @@
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "data_block.h"
+
+using namespace std;
+
+data_block::~data_block() {
+    release();
+}
+
+void data_block::release() {
+    if (!owner)
+        return;
+    if (pool != nullptr)
+        pool->give(arr);
+    else
+        delete[] arr;
+}
+
+data_block::data_block(block_pool &pool) {
+    arr = pool.take();
+    this->pool = &pool;
+    cap = pool.get_block_size();
+    memset(arr, 0, cap);
+}
+
+data_block::data_block(const data_block& d) {
+    size = d.size;
+    cap = d.cap;
+    bno = d.bno;
+    owner = d.owner;
+    pool = d.pool;
+    if (!owner) {
+        arr = d.arr;
+        return;
+    }
+    arr = pool != nullptr ? pool->take() : new char[d.cap];
+    memcpy(arr, d.arr, cap);
+}
+
+data_block::data_block(data_block &&d) noexcept {
+    size = d.size;
+    cap = d.cap;
+    bno = d.bno;
+    owner = d.owner;
+    pool = d.pool;
+    arr = d.arr;
+    // the moved block is left as an empty view
+    d.arr = nullptr;
+    d.owner = false;
+}
+
+data_block::data_block(const char* iarr, size_t size, size_t cap, size_t bno) {
+    this->size = size;
+    this->cap = cap;
+    this->bno = bno;
+    arr = new char[cap];
+    memcpy(arr, iarr, cap);
+}
+
+data_block& data_block::operator=(const data_block& d) {
+    if(this == &d)
+        return *this;
+    // an owned buffer of the same capacity is reused
+    if (owner && d.owner && cap == d.cap) {
+        memcpy(arr, d.arr, cap);
+        size = d.size;
+        bno = d.bno;
+        return *this;
+    }
+    data_block copy(d);
+    return *this = std::move(copy);
+}
+
+data_block &data_block::operator=(data_block &&d) noexcept {
+    if (this == &d)
+        return *this;
+    release();
+    size = d.size;
+    cap = d.cap;
+    bno = d.bno;
+    owner = d.owner;
+    pool = d.pool;
+    arr = d.arr;
+    d.arr = nullptr;
+    d.owner = false;
+    return *this;
+}
+
+data_block data_block::view_of(char *iarr, size_t size, size_t cap, size_t bno) {
+    data_block res;
+    res.owner = false;
+    res.arr = iarr;
+    res.size = size;
+    res.cap = cap;
+    res.bno = bno;
+    return res;
+}
+
+size_t data_block::get_address(size_t index, size_t width) const{
+    if (index * width + width > cap)
+        throw range_error("Address entry index is invalid.");
+    size_t res = 0;
+    for (size_t i = 0; i < width; ++i)
+        res = (res << 8) + (size_t)((unsigned char) arr[index * width + i]);
+    return res;
+}
+
+size_t data_block::get_bno() {
+    return bno;
+}
+
+size_t data_block::get_fb_size() const {
+    size_t i = 0;
+    for (i = 0; i < cap/2-1; i++)
+    {
+        if (!arr[2 * i] && !arr[2 * i + 1]) {
+            break;
+        }
+    }
+    return i;
+}
+
+void data_block::push_address(size_t address) {
+    size = size + 2;
+    if (size > cap) {
+        throw std::invalid_argument("Capacity of block node is full.");
+    }
+    arr[size - 1] = (uint8_t) (address % one_byte);
+    arr[size - 2] = (uint8_t)(address >> 8);
+}
+
+size_t data_block::pop_address() {
+    if (size < 2) {
+        throw std::invalid_argument("Block node is empty.");
+    }
+    size = size - 2;
+    size_t res = 0;
+    res = (size_t) (unsigned char)arr[size+1];
+    res += (((size_t) (unsigned char)arr[size]) << 8);
+
+    arr[size] = 0;
+    arr[size+1] = 0;
+    return res;
+}
+
+void data_block::set_address(size_t index, size_t address, size_t width)
+{
+    if ((index+1)*width > cap) {
+        throw std::range_error("Given index is out of range.");
+    }
+    for (size_t i = width; i > 0; --i) {
+        arr[width*index + i - 1] = uint8_t(address % one_byte);
+        address >>= 8;
+    }
+}
+
+void data_block::clear_block()
+{
+    for (size_t i = 0; i < cap; i++){
+        arr[i] = 0;
+    }
+    size = 0;
+}
+
+data_block::data_block(size_t blk_size) {
+    arr = new char[blk_size];
+    for (size_t i = 0; i < blk_size;i++) {
+        arr[i] = 0;
+    }
+    cap  = blk_size;
+    size = 0;
+    bno = 0;
+}
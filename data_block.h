@@ -0,0 +1,56 @@
+#ifndef OS_MIDTERM_DATA_BLOCK_H
+#define OS_MIDTERM_DATA_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+#include "block_pool.h"
+
+class data_block {
+public:
+    data_block(const char* iarr, size_t size, size_t cap, size_t bno);
+    ~data_block();
+    explicit data_block(size_t blk_size);
+    // zeroed block with a buffer of the pool, copies of it take their buffers from the pool too
+    explicit data_block(block_pool& pool);
+    data_block(const data_block& d);
+    data_block(data_block&& d) noexcept;
+    data_block& operator=(const data_block& d);
+    data_block& operator=(data_block&& d) noexcept;
+    // block that points into the mapped image instead of owning a buffer
+    static data_block view_of(char* iarr, size_t size, size_t cap, size_t bno);
+
+    void push_address(size_t address);
+    size_t pop_address();
+
+    // addresses are big endian, width bytes each, free block nodes use 2 bytes
+    void set_address(size_t index, size_t address, size_t width = 2);
+    void clear_block();
+
+    size_t get_address(size_t index, size_t width = 2) const;
+
+    size_t get_bno();
+
+    //special for free block nodes.
+    size_t get_fb_size() const;
+
+private:
+    data_block() = default;
+    // gives the buffer back to its pool or frees it
+    void release();
+    const static size_t one_byte = 256;
+    const static size_t dir_entry_size = 8;
+    size_t bno = 0;
+    size_t cap = 0;
+    size_t size = 0;
+    char* arr = nullptr;
+    // views don't own arr, copies of a view are views too
+    bool owner = true;
+    // arr came from this pool when it isn't null
+    block_pool* pool = nullptr;
+
+    friend class file_system;
+    friend class buffer_cache;
+};
+
+
+#endif //OS_MIDTERM_DATA_BLOCK_H
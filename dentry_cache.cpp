@@ -0,0 +1,65 @@
+#include <cstdio>
+#include <stdexcept>
+#include "dentry_cache.h"
+
+using namespace std;
+
+const size_t dentry_cache::no_entry;
+
+dentry_cache::dentry_cache(size_t capacity) : capacity(capacity) {
+    if (capacity == 0)
+        throw invalid_argument("Dentry cache capacity should be at least one entry.");
+}
+
+bool dentry_cache::find(size_t dir, const std::string &name, size_t &index) {
+    auto d = dirs.find(dir);
+    if (d != dirs.end()) {
+        auto it = d->second.find(name);
+        if (it != d->second.end()) {
+            index = it->second;
+            if (index == no_entry)
+                negative_hits++;
+            else
+                hits++;
+            return true;
+        }
+    }
+    misses++;
+    return false;
+}
+
+void dentry_cache::insert(size_t dir, const std::string &name, size_t index) {
+    auto& names = dirs[dir];
+    auto it = names.find(name);
+    if (it != names.end()) {
+        it->second = index;
+        return;
+    }
+    // the names are all dropped when there are too many, they are found again by searching
+    if (count >= capacity) {
+        clear();
+        dirs[dir][name] = index;
+    }
+    else {
+        names[name] = index;
+    }
+    count++;
+}
+
+void dentry_cache::erase_dir(size_t dir) {
+    auto d = dirs.find(dir);
+    if (d == dirs.end())
+        return;
+    count -= d->second.size();
+    dirs.erase(d);
+}
+
+void dentry_cache::clear() {
+    dirs.clear();
+    count = 0;
+}
+
+void dentry_cache::print_stats() const {
+    fprintf(stderr, "dentry cache: entries: %zu hits: %zu negative hits: %zu misses: %zu\n",
+            count, hits, negative_hits, misses);
+}
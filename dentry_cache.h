@@ -0,0 +1,42 @@
+#ifndef OS_MIDTERM_DENTRY_CACHE_H
+#define OS_MIDTERM_DENTRY_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+/* Names looked up in directories, (directory i-node, name) -> i-node. Names
+ * that aren't in a directory are kept too, so a path is resolved with one
+ * hash lookup per component once its directories were searched. The file
+ * system keeps the entries up to date when it adds or removes a directory
+ * entry and drops the names of a directory when the directory is removed. */
+class dentry_cache {
+public:
+    // i-node of a name known to be missing
+    static const size_t no_entry = SIZE_MAX;
+
+    explicit dentry_cache(size_t capacity);
+
+    // true when the name is cached, index is no_entry if the directory doesn't have it
+    bool find(size_t dir, const std::string& name, size_t& index);
+    void insert(size_t dir, const std::string& name, size_t index);
+    // forgets the names of the directory
+    void erase_dir(size_t dir);
+    void clear();
+
+    void print_stats() const;
+
+private:
+    size_t capacity;
+    size_t count = 0;
+    // names of every directory, a directory is dropped at once
+    std::unordered_map<size_t, std::unordered_map<std::string, size_t>> dirs;
+
+    size_t hits = 0;
+    size_t negative_hits = 0;
+    size_t misses = 0;
+};
+
+
+#endif //OS_MIDTERM_DENTRY_CACHE_H
@@ -2,12 +2,21 @@
 // Created by selman.ozleyen2017 on 17.05.2020.
 //
 
+#include <algorithm>
 #include <fstream>
 #include "file_system.h"
+#include "lz4_codec.h"
+#include "block_hash.h"
+#include "crc32c.h"
 #include <ctime>
 #include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <mutex>
+#include <thread>
 #include <iostream>
 #include <map>
 #include <set>
@@ -16,99 +25,362 @@
 
 using namespace std;
 
+static bool is_zero(const char* p, size_t len) {
+    // the rest is compared with the bytes before it
+    return len == 0 || (p[0] == 0 && memcmp(p, p + 1, len - 1) == 0);
+}
 
 const char file_system::months[][4]= {
     "Jan", "Feb", "Mar", "Apr", "May", "Jun",
     "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
 };
+const size_t file_system::ra_initial_window;
+const size_t file_system::ra_window_limit;
+const size_t file_system::max_blocks_per_group;
+const size_t file_system::inline_extents;
+const size_t file_system::dir_name_size;
+const size_t file_system::max_long_name_size;
+const size_t file_system::min_journal_blocks;
+const size_t file_system::max_journal_blocks;
+
+// i-node of format v1, 16 bit addresses and 32 bit size
+struct disk_inode_v1 {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint32_t size;
+    uint8_t type;
+    uint16_t link_count;
+    uint16_t ba[5];
+    uint16_t si;
+    uint16_t di;
+    uint16_t ti;
+};
+
+// i-node of format v2, 32 bit addresses and 64 bit size
+struct disk_inode_v2 {
+    uint16_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    uint8_t type;
+    uint64_t size;
+    uint16_t link_count;
+    uint16_t flags;
+    // with inode_extents the same bytes hold the extents
+    union {
+        struct {
+            uint32_t ba[5];
+            uint32_t si;
+            uint32_t di;
+            uint32_t ti;
+            // feature_dir_index, root block of the index of a directory
+            uint32_t index;
+        } blocks;
+        struct {
+            uint32_t count;
+            file_extent ext[3];
+            uint32_t block;
+        } extents;
+    } map;
+};
+
+// superblock as it is stored at the beginning of block 0
+struct disk_superblock {
+    uint16_t block_size;
+    uint16_t root_dir_address;
+    uint16_t inode_pos;
+    uint16_t inode_count;
+    uint16_t free_inode_count;
+    uint16_t fb_count;
+    uint16_t fb_head;
+    uint16_t fb_tail;
+    // images with a magic
+    uint32_t magic;
+    uint32_t features;
+    uint32_t bitmap_pos;
+    uint32_t bitmap_blocks;
+    uint32_t group_count;
+    uint32_t blocks_per_group;
+    uint32_t inodes_per_group;
+    uint32_t cluster_blocks;
+    // feature_v2, the fields that don't fit in 16 bits
+    struct {
+        uint64_t block_count;
+        uint64_t fb_count;
+        uint32_t root_dir_address;
+        uint32_t inode_pos;
+        uint32_t inode_count;
+        uint32_t free_inode_count;
+    } wide;
+    // feature_dedup
+    uint32_t dedup_pos;
+    uint32_t dedup_blocks;
+    // feature_metadata_csum, the checksum is of this structure with it set to 0
+    uint32_t csum_pos;
+    uint32_t csum_blocks;
+    // feature_journal
+    uint32_t journal_pos;
+    uint32_t journal_blocks;
+    uint32_t checksum;
+};
+
+static_assert(sizeof(disk_inode_v1) == 32, "v1 i-node should be 32 bytes");
+static_assert(sizeof(disk_inode_v2) == 64, "v2 i-node should be 64 bytes");
+static_assert(sizeof(file_extent) == 12, "extents are stored as they are");
+static_assert(sizeof(dedup_record) == 16, "dedup records are stored as they are");
+// inline data starts at the block map and continues to the end of the larger i-node
+static_assert(offsetof(disk_inode_v2, map) + sizeof(inode::inline_data) == 128,
+              "inline data should fill the i-node");
+static_assert(sizeof(disk_superblock) <= 128, "superblock should end before the group descriptors");
 
 /* Assumes the parameters are correct */
-file_system::file_system(size_t block_size, size_t inode_count) {
+file_system::file_system(size_t block_size, size_t inode_count, const format_options& format) {
+    uint32_t features = format.features;
+    if (format.image_size != 0 || (features & (feature_extents | feature_inline_data | feature_dir_index | feature_long_names |
+                                               feature_compress | feature_dedup | feature_metadata_csum |
+                                               feature_data_csum | feature_journal)))
+        features |= feature_v2;
+    if (features & feature_data_csum)
+        features |= feature_metadata_csum;
+    if (features & (feature_groups | feature_v2))
+        features |= feature_bitmap;
     inodes.resize(inode_count);
-    sb.inode_count = (uint16_t)inode_count;
-    sb.free_inode_count = ((uint16_t)inode_count) - 1;
+    sb.inode_count = inode_count;
+    sb.free_inode_count = inode_count - 1;
     sb.block_size = block_size;
     sb.inode_pos = 1;
+    sb.magic = features != 0 ? sb_magic : 0;
+    sb.features = features;
+    sb.bitmap_pos = 0;
+    sb.bitmap_blocks = 0;
+    sb.group_count = 0;
+    sb.blocks_per_group = 0;
+    sb.inodes_per_group = 0;
+    sb.cluster_blocks = 0;
+    sb.dedup_pos = 0;
+    sb.dedup_blocks = 0;
+    sb.csum_pos = 0;
+    sb.csum_blocks = 0;
+    sb.journal_pos = 0;
+    sb.journal_blocks = 0;
+    // the hash index is one table next to the bitmap and shared blocks can't be rewritten by clusters
+    if ((features & feature_dedup) && (features & (feature_groups | feature_compress)))
+        throw invalid_argument("Deduplication can't be used with allocation groups or compression.");
+    if (features & feature_compress) {
+        // a cluster of one block can't take fewer blocks when compressed
+        if (format.cluster_blocks < 2)
+            throw invalid_argument("A compression cluster should have at least 2 blocks.");
+        sb.cluster_blocks = format.cluster_blocks;
+    }
     block_size_byte = KB * block_size;
+    size_t total_blocks = (KB) / block_size;
+    if (has_feature(feature_v2)) {
+        inode_size = has_feature(feature_inline_data) ? inline_inode_size : v2_inode_size;
+        addr_size = 4;
+        uint64_t image_size = format.image_size != 0 ? format.image_size : (uint64_t) KB * KB;
+        if (image_size / block_size_byte > UINT32_MAX)
+            throw invalid_argument("Image has more blocks than 32 bit addresses can reach.");
+        total_blocks = image_size / block_size_byte;
+    }
+    sb.block_count = total_blocks;
+    if (has_feature(feature_journal)) {
+        sb.journal_blocks = format.journal_blocks != 0 ? format.journal_blocks : default_journal_blocks();
+        if (sb.journal_blocks < journal::min_blocks)
+            throw invalid_argument("Journal should have at least " + to_string(journal::min_blocks) + " blocks.");
+    }
     node_cap = block_size_byte / 2 - 1;
-    block_cap = node_cap + 1;
+    block_cap = block_size_byte / addr_size;
     size_t inodes_block_count = ceil(((double)inode_size * inode_count) / ((double)block_size_byte));
     size_t inodes_pos_end = sb.inode_pos + inodes_block_count;
 
-    sb.root_dir_address = inodes_pos_end;
-    size_t total_blocks = (KB) / block_size;
-    // After filling inodes
-    size_t last_free_block = total_blocks - 2;
-    // position of the first free block
-    size_t fb_pos = sb.root_dir_address + 1;
-    size_t node_address_count = block_size_byte / 2 - 2;
-    for (size_t i = fb_pos, j = 0; i < last_free_block + 1; ++i, ++j) {
-        if (j == node_address_count + 1) {
-            j = 0;
-            last_free_block--;
+    if (has_feature(feature_groups)) {
+        /* Layout Order: SB + GROUP DESCRIPTORS -> (BITMAP -> INODES -> CHECKSUMS -> FREE BLOCKS) for every group,
+         * the root dir is the first data block of group 0 and the journal is a run of data blocks after it */
+        layout_groups(total_blocks, format.group_count);
+        sb.root_dir_address = bitmap.find_free(0);
+        take_block(sb.root_dir_address);
+        groups[0].free_inodes--;
+        if (has_feature(feature_journal)) {
+            size_t run = bitmap.find_free_run(sb.journal_blocks, sb.root_dir_address);
+            if (run == block_bitmap::npos)
+                throw invalid_argument("Journal doesn't fit between the group metadata, use fewer groups.");
+            sb.journal_pos = run;
+            for (size_t i = 0; i < sb.journal_blocks; ++i)
+                take_block(run + i);
+        }
+    }
+    else if (has_feature(feature_bitmap)) {
+        /* Layout Order: SB -> INODES -> BITMAP -> DEDUP TABLE -> CHECKSUMS -> JOURNAL -> ROOT_DIR -> FREE BLOCKS,
+         * the dedup table, the checksums and the journal are only there with their features */
+        sb.bitmap_pos = inodes_pos_end;
+        sb.bitmap_blocks = (total_blocks + 8 * block_size_byte - 1) / (8 * block_size_byte);
+        if (has_feature(feature_dedup)) {
+            sb.dedup_pos = sb.bitmap_pos + sb.bitmap_blocks;
+            sb.dedup_blocks = dedup_table_blocks();
+        }
+        if (has_feature(feature_metadata_csum)) {
+            sb.csum_pos = sb.bitmap_pos + sb.bitmap_blocks + sb.dedup_blocks;
+            sb.csum_blocks = (total_blocks * sizeof(uint32_t) + block_size_byte - 1) / block_size_byte;
+        }
+        if (has_feature(feature_journal))
+            sb.journal_pos = sb.bitmap_pos + sb.bitmap_blocks + sb.dedup_blocks + sb.csum_blocks;
+        sb.root_dir_address = sb.bitmap_pos + sb.bitmap_blocks + sb.dedup_blocks + sb.csum_blocks + sb.journal_blocks;
+        if ((size_t) sb.root_dir_address + 1 >= total_blocks)
+            throw invalid_argument("I-node count is too big.");
+        sb.fb_head = 0;
+        sb.fb_tail = 0;
+        sb.fb_count = total_blocks - sb.root_dir_address - 1;
+        bitmap.reset(total_blocks, 8 * block_size_byte);
+        for (size_t i = 0; i <= sb.root_dir_address; ++i)
+            bitmap.set(i);
+    }
+    else {
+        sb.root_dir_address = inodes_pos_end;
+        // After filling inodes
+        size_t last_free_block = total_blocks - 2;
+        // position of the first free block
+        size_t fb_pos = sb.root_dir_address + 1;
+        size_t node_address_count = block_size_byte / 2 - 2;
+        for (size_t i = fb_pos, j = 0; i < last_free_block + 1; ++i, ++j) {
+            if (j == node_address_count + 1) {
+                j = 0;
+                last_free_block--;
+            }
         }
+        sb.fb_head = total_blocks - 1;
+        sb.fb_tail = last_free_block + 1;
+        sb.fb_count = total_blocks - fb_pos;
+        if (fb_pos > sb.fb_tail || sb.fb_count < 1)
+            throw invalid_argument("I-node count is too big.");
     }
-    sb.fb_head = total_blocks - 1;
-    sb.fb_tail = last_free_block + 1;
-    sb.fb_count = total_blocks - fb_pos;
     //fill root dir inode
-    if (fb_pos > sb.fb_tail || sb.fb_count < 1)
-        throw invalid_argument("I-node count is too big.");
     init_inode(0);
     // one for . and one for ..
-    inodes[0].size = data_block::dir_entry_size*2;
-    inodes[0].ba[0] = sb.root_dir_address;
+    inodes[0].size = empty_dir_size();
+    // directories are always kept in blocks
+    inodes[0].flags &= ~inode_inline_data;
+    if (has_feature(feature_dir_index))
+        inodes[0].flags &= ~inode_extents;
+    if (inodes[0].flags & inode_extents) {
+        inodes[0].ext[0] = file_extent{0, sb.root_dir_address, 1};
+        inodes[0].ext_count = 1;
+    }
+    else
+        inodes[0].ba[0] = sb.root_dir_address;
     inodes[0].type = dir_type;
     inodes[0].link_count = 1;
+    load_inode_map();
+}
+
+void file_system::layout_groups(size_t total_blocks, size_t group_count) {
+    if (group_count == 0)
+        throw invalid_argument("There should be at least one allocation group.");
+    // a group is covered by one bitmap block and searched in whole words
+    size_t per_group = (total_blocks + group_count - 1) / group_count;
+    per_group = min((per_group + 63) / 64 * 64, min(8 * block_size_byte, max_blocks_per_group));
+    group_count = (total_blocks + per_group - 1) / per_group;
+    // inode table slices are made of whole blocks
+    size_t per_iblock = block_size_byte / inode_size;
+    size_t ipg = (sb.inode_count + group_count - 1) / group_count;
+    ipg = (ipg + per_iblock - 1) / per_iblock * per_iblock;
+    if (ipg > UINT16_MAX)
+        throw invalid_argument("Too many i-nodes for a group, use more groups.");
+    sb.group_count = group_count;
+    sb.blocks_per_group = per_group;
+    sb.inodes_per_group = ipg;
+    sb.bitmap_blocks = group_count;
+    sb.fb_head = 0;
+    sb.fb_tail = 0;
+    sb.fb_count = 0;
+    bitmap.reset(total_blocks, per_group);
+    groups.resize(group_count);
+    // the group descriptor table takes the blocks after the superblock if it doesn't fit in block 0
+    size_t gdt_end = gdt_blocks();
+    for (size_t g = 0; g < group_count; ++g) {
+        group_desc& gd = groups[g];
+        size_t end = min(total_blocks, (g + 1) * per_group);
+        size_t first_inode = min<size_t>(g * ipg, sb.inode_count);
+        size_t inode_count = min<size_t>(ipg, sb.inode_count - first_inode);
+        gd.first_block = g * per_group;
+        // group 0 starts with the superblock
+        gd.bitmap_pos = g == 0 ? gdt_end : gd.first_block;
+        gd.inode_table = gd.bitmap_pos + 1;
+        // the checksums of the blocks of the group follow its inode table
+        size_t data_start = gd.inode_table + (inode_count + per_iblock - 1) / per_iblock + csum_group_blocks();
+        if (data_start >= end)
+            throw invalid_argument("I-node count is too big.");
+        for (size_t i = gd.first_block; i < data_start; ++i)
+            bitmap.set(i);
+        gd.free_blocks = end - data_start;
+        gd.free_inodes = inode_count;
+        sb.fb_count += gd.free_blocks;
+    }
+    sb.inode_pos = groups[0].inode_table;
+    sb.bitmap_pos = groups[0].bitmap_pos;
 }
 
 void file_system::create_file(const char* filename_arg)  {
 
     /* Initial Layout Order: SB -> INODES  -> ROOT_DIR -> FREE BLOCKS -> FREE_BLOCKS_LIST*/
-    ofstream file;
-    file.open(filename_arg, ios::binary | ios::out);
-    file.exceptions ( std::ios::failbit | std::ios::badbit );
-    file.write((char*)&sb, sizeof(superblock));
-    if (sizeof(superblock) < block_size_byte) {
-        // Note: Won't work on machines where char is not 1 byte.
-        size_t remaining = block_size_byte - sizeof(superblock);
-        char* temp = new char[remaining];
-        file.write(temp, remaining);
-        delete[] temp;
-    }
-    const inode* iarr = inodes.data();
-    size_t inode_blks = sb.root_dir_address - sb.inode_pos;
-    if (sb.root_dir_address < sb.inode_pos)
+    dev.create(filename_arg);
+    dev.set_block_size(block_size_byte);
+    // Note: Won't work on machines where char is not 1 byte.
+    char * zero_chars = new char[block_size_byte]();
+    // with a bitmap the image is sized up front, the blocks never written read as zeros
+    if (has_feature(feature_bitmap))
+        dev.truncate(total_block_count() * block_size_byte);
+    // the group descriptor table may continue after block 0
+    size_t sb_blocks = groups.empty() ? 1 : gdt_blocks();
+    vector<char> region(sb_blocks * block_size_byte, 0);
+    encode_superblock(region.data());
+    if (!groups.empty())
+        memcpy(region.data() + gdt_offset, groups.data(), groups.size() * sizeof(group_desc));
+    for (size_t i = 0; i < sb_blocks; ++i)
+        dev.write_block(i, region.data() + i * block_size_byte);
+
+    size_t inode_blks = inode_table_blocks();
+    if (groups.empty() && sb.root_dir_address < sb.inode_pos + inode_blks)
         throw std::length_error("Couldn't calculate inode_blocks.");
-    file.write((char*)iarr, sizeof(inode) * sb.inode_count);
-    if (inode_blks * block_size_byte > sizeof(inode) * sb.inode_count) {
-        size_t remaining = inode_blks * block_size_byte - sizeof(inode) * sb.inode_count;
-        char* temp = new char[remaining];
-        file.write(temp, remaining);
-        delete[] temp;
+    vector<char> itable(inode_blks * block_size_byte, 0);
+    for (size_t i = 0; i < inodes.size(); ++i)
+        encode_inode(inodes[i], itable.data() + i * inode_size);
+    if (groups.empty()) {
+        dev.write_at(sb.inode_pos * block_size_byte, itable.data(), itable.size());
     }
-    // Going to write block by block the free block nodes
-    char * zero_chars = new char[block_size_byte];
-    for (size_t i = 0; i < block_size_byte;i++) {
-        zero_chars[i] = 0;
+    else {
+        for (size_t i = 0; i < inode_blks; ++i)
+            dev.write_block(itable_block_no(i), itable.data() + i * block_size_byte);
     }
+    for (size_t i = 0; i < bitmap.block_count(); ++i) {
+        dev.write_at(bitmap_block_no(i) * block_size_byte, bitmap.block_bytes(i), bitmap.bytes_per_block());
+        bitmap.clean(i);
+    }
+    // Going to write block by block the free block nodes
     size_t cap = block_size_byte / 2 - 1;
 
     // Root directory data block currently has . and .. dir entries
     data_block temp(zero_chars,0,block_size_byte,sb.root_dir_address);
     init_directory(temp,0,0);
-    file.write((char*)temp.arr, block_size_byte);
+    dev.write_block(temp.bno, temp.arr);
     data_block zero(zero_chars,0,block_size_byte,0);
     // Root directory is written it turn for writing free blocks
-    for (size_t i = sb.root_dir_address + 1; i < sb.fb_tail; ++i) {
-        file.write((char*)zero.arr, block_size_byte);
+    size_t free_end = has_feature(feature_bitmap) ? 0 : sb.fb_tail;
+    for (size_t i = sb.root_dir_address + 1; i < free_end; ++i) {
+        zero.bno = i;
+        dev.write_block(zero.bno, zero.arr);
     }
 
     // this is the address for the first free block
     size_t j = sb.root_dir_address + 1;
     // Now writing the free block nodes
-    for (uint16_t i = sb.fb_tail; i <= sb.fb_head; ++i) {
-        data_block temp1(zero_chars,0,block_size_byte,0);
+    for (uint16_t i = sb.fb_tail; sb.fb_tail != 0 && i <= sb.fb_head; ++i) {
+        data_block temp1(zero_chars,0,block_size_byte,i);
         for (size_t k = 0; k < cap; k++) {
             if (sb.fb_tail > j)
                 temp1.push_address(j++);
@@ -117,10 +389,39 @@ void file_system::create_file(const char* filename_arg)  {
         }
         if (i != sb.fb_head)
             temp1.set_address(node_cap,i+1);
-        file.write(temp1.arr, block_size_byte);
+        dev.write_block(temp1.bno, temp1.arr);
+    }
+    if (has_feature(feature_metadata_csum)) {
+        // the metadata written above is read back for its checksums, the rest of the table is zeros
+        vector<size_t> meta;
+        for (size_t i = 0; i < sb_blocks; ++i)
+            meta.push_back(i);
+        for (size_t i = 0; i < inode_blks; ++i)
+            meta.push_back(itable_block_no(i));
+        for (size_t i = 0; i < bitmap.block_count(); ++i)
+            meta.push_back(bitmap_block_no(i));
+        meta.push_back(sb.root_dir_address);
+        map<size_t, vector<char>> table;
+        vector<char> blk(block_size_byte);
+        for (auto bno : meta) {
+            dev.read_block(bno, blk.data());
+            uint32_t sum = crc32c::of(blk.data(), block_size_byte);
+            size_t tblk, off;
+            csum_record_pos(bno, tblk, off);
+            vector<char>& t = table[tblk];
+            t.resize(block_size_byte, 0);
+            memcpy(t.data() + off, &sum, sizeof(sum));
+        }
+        for (auto& t : table)
+            dev.write_block(t.first, t.second.data());
     }
+    // the blocks after the header of an empty log are never read
+    if (has_feature(feature_journal))
+        journal::format(dev, sb.journal_pos, sb.journal_blocks, block_size_byte);
     delete[] zero_chars;
-    file.close();
+    // everything is on the disk now
+    sb_dirty = false;
+    dev.close();
 }
 
 void file_system::init_inode(size_t i) {
@@ -137,16 +438,33 @@ void file_system::init_inode(size_t i) {
     for (auto & j : inodes[i].ba){
         j = 0;
     }
+    inodes[i].flags = new_inode_flags();
+    inodes[i].ext_count = 0;
+    inodes[i].ext_block = 0;
+    inodes[i].index_block = 0;
 
 }
 
-std::vector<char> file_system::create_dir_entry(uint16_t index,const std::string& dirname) const {
+std::vector<char> file_system::create_dir_entry(uint16_t index,const std::string& dirname, uint8_t type) const {
     if(dirname.empty())
         throw invalid_argument("Please enter a valid file/directory name.");
-    if (dirname.size() > 6)
-        throw invalid_argument("Directory/File name cannot be longer than 6 characters.");
+    if (dirname.size() > max_name_size())
+        throw invalid_argument("Directory/File name cannot be longer than " + to_string(max_name_size()) + " characters.");
     if ((dirname.find('/') != string::npos) || (dirname.find(' ') != string::npos))
         throw invalid_argument("Directory/File name is invalid.");
+    if (has_feature(feature_long_names)) {
+        // | inode 2 | record length 2 | name length 1 | type 1 | name |
+        vector<char> res(dir_record_size(dirname.size()), 0);
+        size_t rec_len = res.size();
+        res[0] = (char) (index >> 8);
+        res[1] = (char) index;
+        res[2] = (char) (rec_len >> 8);
+        res[3] = (char) rec_len;
+        res[4] = (char) dirname.size();
+        res[5] = (char) type;
+        memcpy(res.data() + long_entry_header, dirname.data(), dirname.size());
+        return res;
+    }
     vector<char> res{0,0,0,0,0,0,0,0};
     res[1] = (uint8_t)(index % data_block::one_byte);
     res[0] = (uint8_t)((index >> 8) % data_block::one_byte);
@@ -158,196 +476,883 @@ std::vector<char> file_system::create_dir_entry(uint16_t index,const std::string
 
     return res;
 }
+bool file_system::next_dir_entry(const char *arr, size_t size, size_t off, dir_entry &ent) const {
+    if (!has_feature(feature_long_names)) {
+        if (off + data_block::dir_entry_size > size) {
+            if (off < size)
+                throw logic_error("Data block directory entries are corrupted.");
+            return false;
+        }
+        ent.inode = ((size_t)(uint8_t) arr[off] << 8) + (uint8_t) arr[off + 1];
+        ent.type = 0;
+        ent.name = arr + off + 2;
+        ent.name_len = strnlen(ent.name, dir_name_size);
+        ent.rec_len = data_block::dir_entry_size;
+        return true;
+    }
+    if (off + long_entry_header > size)
+        return false;
+    const uint8_t* p = (const uint8_t*) arr + off;
+    ent.inode = ((size_t) p[0] << 8) + p[1];
+    ent.rec_len = ((size_t) p[2] << 8) + p[3];
+    ent.name_len = p[4];
+    ent.type = p[5];
+    ent.name = arr + off + long_entry_header;
+    // an entry never continues in the next block
+    if (ent.name_len == 0 || ent.rec_len < dir_record_size(ent.name_len) || off + ent.rec_len > size)
+        throw logic_error("Data block directory entries are corrupted.");
+    return true;
+}
+
+void file_system::dir_start(dir_cursor &dc, const inode &dir) {
+    ra_start(dc.ra, dir);
+    dc.blk = data_block::view_of(nullptr, 0, block_size_byte, 0);
+    dc.off = 0;
+    dc.pos = 0;
+}
+
+bool file_system::dir_next(dir_cursor &dc, dir_entry &ent) {
+    // the next block is read ahead when the entries of the current one run out
+    while (!next_dir_entry(dc.blk.arr, dc.blk.size, dc.off, ent)) {
+        if (dc.ra.next >= dc.ra.block_count)
+            return false;
+        dc.blk = ra_next(dc.ra);
+        dc.off = 0;
+    }
+    dc.pos = (dc.ra.next - 1) * block_size_byte + dc.off;
+    dc.off += ent.rec_len;
+    return true;
+}
+
+bool file_system::entry_is(const dir_entry &ent, const std::string &name) {
+    return ent.name_len == name.size() && memcmp(ent.name, name.data(), ent.name_len) == 0;
+}
+
+size_t file_system::dir_record_size(size_t name_len) const {
+    if (!has_feature(feature_long_names))
+        return data_block::dir_entry_size;
+    // entries start at 4 byte boundaries
+    return (long_entry_header + name_len + 3) / 4 * 4;
+}
+
+size_t file_system::max_name_size() const {
+    return has_feature(feature_long_names) ? max_long_name_size : dir_name_size;
+}
+
+size_t file_system::empty_dir_size() const {
+    return dir_record_size(1) + dir_record_size(2);
+}
+
 //size will be evaluated with its first 24 bits
-void file_system::add_inode_size(size_t index, uint32_t size)
+void file_system::add_inode_size(size_t index, uint64_t size)
 {
     inode & i = inodes[index];
     i.size+=size;
 }
 
-file_system::file_system(const char* filename) {
+file_system::file_system(const char* filename, const fs_options& opts) {
     this->filename = filename;
-    fstream file(filename,ios::binary| ios::out | ios::in);
-    file.exceptions ( std::ios::failbit | std::ios::badbit );
-    // reading the superblock
-    file.read((char*)&sb, sizeof(sb));
+    dev.open(filename, opts.mode);
+    cache.set_capacity(opts.cache_blocks);
+    // reading the superblock, the smallest block is larger than all of its fields
+    char sb_bytes[sizeof(disk_superblock)];
+    dev.read_at(0, sb_bytes, sizeof(sb_bytes));
+    decode_superblock(sb_bytes);
     block_size_byte = (sb.block_size << 10);
+    if (has_feature(feature_v2)) {
+        inode_size = has_feature(feature_inline_data) ? inline_inode_size : v2_inode_size;
+        addr_size = 4;
+    }
     node_cap = block_size_byte / 2 - 1;
-    block_cap = node_cap + 1;
+    block_cap = block_size_byte / addr_size;
+    dev.set_block_size(block_size_byte);
+    pool.set_block_size(block_size_byte);
+    cache.set_block_size(block_size_byte);
+    if (has_feature(feature_journal)) {
+        // the logged superblock may be newer than the one in its place
+        jrnl.open(sb.journal_pos, sb.journal_blocks, block_size_byte, opts.commit_interval);
+        dev.read_at(0, sb_bytes, sizeof(sb_bytes));
+        decode_superblock(sb_bytes);
+    }
     //reading inodes
-
-    file.seekg(sb.inode_pos * block_size_byte);
-    auto* temp_inodes = new inode[sb.inode_count];
-    file.read((char*)temp_inodes, ((size_t)sb.inode_count)* ((size_t) inode_size));
-    for (size_t i = 0; i < sb.inode_count; ++i) {
-        inodes.emplace_back(temp_inodes[i]);
+    inodes.resize(sb.inode_count);
+    itable_dirty.assign(inode_table_blocks(), false);
+    if (has_feature(feature_groups)) {
+        groups.resize(sb.group_count);
+        dev.read_at(gdt_offset, (char*)groups.data(), groups.size() * sizeof(group_desc));
+    }
+    vector<char> itable(inodes.size() * inode_size);
+    if (has_feature(feature_groups)) {
+        // the slices of the inode table are read one by one
+        size_t per_block = block_size_byte / inode_size;
+        for (size_t i = 0; i < itable_dirty.size(); ++i) {
+            size_t count = min(per_block, inodes.size() - i * per_block);
+            dev.read_at(itable_block_no(i) * block_size_byte, &itable[i * per_block * inode_size],
+                        count * inode_size);
+        }
     }
+    else {
+        dev.read_at(sb.inode_pos * block_size_byte, itable.data(), itable.size());
+    }
+    for (size_t i = 0; i < inodes.size(); ++i)
+        decode_inode(&itable[i * inode_size], inodes[i]);
+    load_inode_map();
+    if (has_feature(feature_bitmap)) {
+        size_t per_block = has_feature(feature_groups) ? sb.blocks_per_group : 8 * block_size_byte;
+        bitmap.reset(total_block_count(), per_block);
+        vector<char> bytes(bitmap.block_count() * bitmap.bytes_per_block());
+        for (size_t i = 0; i < bitmap.block_count(); ++i)
+            dev.read_at(bitmap_block_no(i) * block_size_byte, &bytes[i * bitmap.bytes_per_block()],
+                        bitmap.bytes_per_block());
+        bitmap.load(bytes.data());
+    }
+    if (has_feature(feature_metadata_csum)) {
+        csum_verified.assign(total_block_count(), false);
+        if (opts.check_metadata)
+            verify_metadata();
+    }
+}
 
-    delete[] temp_inodes;
-    file.close();
+file_system::~file_system() {
+    // every operation commits itself when it succeeds, the blocks left with a journal belong to one
+    // that failed, they are thrown away and the image stays as the last transaction left it
+    if (jrnl.is_open()) {
+        cache.clear();
+    }
+    else {
+        // without a journal an operation that failed half way leaves its writes on the disk as before
+        try {
+            sync();
+        }
+        catch (exception& e) {
+            cerr << e.what() << endl;
+        }
+    }
+    if (getenv("FS_STATS") != nullptr) {
+        dev.print_stats();
+        cache.print_stats();
+        pool.print_stats();
+        dcache.print_stats();
+        fprintf(stderr, "readahead: %zu blocks max window: %zu\n", ra_blocks, ra_max_used);
+        if (jrnl.is_open())
+            jrnl.print_stats();
+    }
 }
 
 uint16_t file_system::get_dir_inode(std::string path) {
     if (path == "/")
         return 0;
-    // remove the front '/'
-    path = path.erase(0,1);
-    return get_dir_inode_helper(path, inodes[0]);
-}
-
-uint16_t file_system::get_dir_inode_helper(std::string& path,const inode& i) {
-    size_t slash_i = path.find('/');
-    //load the blocks that inode is referring to
-    //resets inode blocks
-    inode_blocks.clear();
-    load_inode_blocks(i);
-    // if we are on the last level
-    bool last_level = string::npos == slash_i || path.size() == slash_i + 1;
-    string searched = path;
-    if (last_level) {
-        //if it is a directory remove the last '/'
-        if (path.size() == slash_i + 1) {
-            searched.pop_back();
-        }
-    }
-    else {
-        // select next dir name
-        searched = string(path, 0, slash_i);
-        // delete the selected one
-        path = path.substr(slash_i, path.size() - slash_i);
-    }
-
-    for (auto& in : inode_blocks) {
-        for (size_t j = 0; j < in.get_dir_entry_count(); ++j) {
-            if (in.get_entry_name(j) == searched) {
-                if (last_level) {
-                    //resets inode blocks
-                    size_t res = in.get_entry_inode_no(j);
-                    inode_blocks.clear();
-                    return res;
-                }
-                else {
-                    string new_path = string(path,1,path.size());
-                    return get_dir_inode_helper(new_path, inodes[in.get_entry_inode_no(j)]);
-                }
-            }
+    // every name of the path is looked up in the directory before it, starting from the root
+    size_t dir = 0;
+    size_t pos = 1;
+    for (;;) {
+        size_t slash_i = path.find('/', pos);
+        // if we are on the last level, a directory may end with '/'
+        bool last_level = slash_i == string::npos || slash_i + 1 == path.size();
+        string searched = path.substr(pos, slash_i == string::npos ? string::npos : slash_i - pos);
+        size_t found = 0;
+        if (!lookup_entry(dir, searched, found))
+            throw invalid_argument("No such directory.");
+        if (last_level)
+            return found;
+        dir = found;
+        pos = slash_i + 1;
+    }
+}
+
+bool file_system::lookup_entry(size_t dir, const std::string &name, size_t &index) {
+    // only the names of directories are cached, they change with their entries
+    bool cached = inodes[dir].type == dir_type;
+    if (cached && dcache.find(dir, name, index))
+        return index != dentry_cache::no_entry;
+    bool found = search_dir(inodes[dir], name, index);
+    if (cached)
+        dcache.insert(dir, name, found ? index : dentry_cache::no_entry);
+    return found;
+}
+
+bool file_system::search_dir(const inode &i, const std::string &name, size_t &index) {
+    // indexed directories are searched without reading their entries
+    if (i.flags & inode_dir_index)
+        return dir_index_lookup(i, name, index);
+    // the search stops at the first match, the blocks after it aren't read
+    dir_cursor dc;
+    dir_start(dc, i);
+    dir_entry ent;
+    while (dir_next(dc, ent)) {
+        if (entry_is(ent, name)) {
+            index = ent.inode;
+            return true;
         }
     }
-    throw invalid_argument("No such directory.");
+    return false;
 }
 
-// changes inode blocks
-void file_system::load_inode_blocks(inode i) {
-    size_t size = get_inode_size(i);
-    auto block_count = (size_t) ceil((double)size / (double)block_size_byte);
-    size_t rem_block_count = block_count;
-    size_t j = 0;
-    for (j = 0; j < direct_count && rem_block_count > 1; ++j) {
-        load_by_block_no(i.ba[j], block_size_byte);
-        inode_blocks.emplace_back(temp_blocks.back());
-        temp_blocks.pop_back();
-        size -= block_size_byte;
-        rem_block_count--;
-    }
-    if (rem_block_count == 1 && j < direct_count) {
-        load_by_block_no(i.ba[j], size);
-        inode_blocks.emplace_back(temp_blocks.back());
-        temp_blocks.pop_back();
+void file_system::load_block_map(const inode& i, std::vector<size_t>& res) {
+    uint64_t size = get_inode_size(i);
+    auto rem_block_count = (size_t) ceil((double)size / (double)block_size_byte);
+    // blocks that aren't mapped are holes and given as 0
+    if (i.flags & inode_extents) {
+        vector<file_extent> ext;
+        load_extents(i, ext);
+        size_t first = res.size();
+        res.resize(first + rem_block_count, 0);
+        for (auto& e : ext) {
+            for (size_t b = 0; b < e.len && e.lblk + b < rem_block_count; ++b)
+                res[first + e.lblk + b] = e.pblk + b;
+        }
         return;
     }
-    if (rem_block_count == 0)
-        return;
+    for (size_t j = 0; j < direct_count && rem_block_count > 0; ++j) {
+        res.push_back(i.ba[j]);
+        rem_block_count--;
+    }
     // if there is still blocks to load use indirect blocks
-    if (i.si == 0)
-        throw logic_error("I-node structure and the attributes doesn't match");
-    load_inode_blocks_helper(i.si, &size, &rem_block_count, 1);
-    if (rem_block_count == 0)
-        return;
+    load_block_map_helper(i.si, &rem_block_count, 1, res);
     // If there is still blocks remaining use double indirect blocks
-    if (i.di == 0)
-        throw logic_error("I-node structure and the attributes doesn't match");
-    load_inode_blocks_helper(i.di, &size, &rem_block_count, 2);
-    if (rem_block_count == 0)
+    load_block_map_helper(i.di, &rem_block_count, 2, res);
+    // If there is still blocks remaining use triple indirect blocks
+    load_block_map_helper(i.ti, &rem_block_count, 3, res);
+}
+
+void file_system::load_block_map_helper(size_t bno, size_t* rem_blocks, size_t level, std::vector<size_t>& res) {
+    if (*rem_blocks == 0)
         return;
-    // If there is still blocks remaining use double indirect blocks
-    if (i.ti == 0)
-        throw logic_error("I-node structure and the attributes doesn't match");
-    load_inode_blocks_helper(i.ti, &size, &rem_block_count, 3);
-    if (rem_block_count == 0)
+    if (level == 0) {
+        res.push_back(bno);
+        *rem_blocks -= 1;
+        return;
+    }
+    if (bno == 0) {
+        // every block under a missing indirect block is a hole
+        size_t span = 1;
+        for (size_t l = 0; l < level && span < *rem_blocks; ++l)
+            span *= block_cap;
+        size_t holes = min(span, *rem_blocks);
+        res.insert(res.end(), holes, 0);
+        *rem_blocks -= holes;
+        return;
+    }
+    load_by_block_no(bno, block_size_byte);
+    data_block temp = std::move(temp_blocks.back());
+    temp_blocks.pop_back();
+    for (size_t i = 0; i < block_cap && *rem_blocks > 0; ++i) {
+        load_block_map_helper(temp.get_address(i, addr_size), rem_blocks, level - 1, res);
+    }
+}
+
+size_t file_system::bmap(const inode& i, size_t lblk) {
+    if (i.flags & inode_extents)
+        return extent_bmap(i, lblk);
+    if (lblk < direct_count)
+        return i.ba[lblk];
+    lblk -= direct_count;
+    if (lblk < block_cap)
+        return indirect_address(i.si, lblk);
+    lblk -= block_cap;
+    if (lblk < block_cap * block_cap)
+        return indirect_address(indirect_address(i.di, lblk / block_cap), lblk % block_cap);
+    lblk -= block_cap * block_cap;
+    size_t l1 = indirect_address(i.ti, lblk / (block_cap * block_cap));
+    return indirect_address(indirect_address(l1, (lblk / block_cap) % block_cap), lblk % block_cap);
+}
+
+size_t file_system::indirect_address(size_t bno, size_t index) {
+    if (bno == 0)
+        return 0;
+    return get_block(bno).get_address(index, addr_size);
+}
+
+void file_system::load_extents(const inode &i, std::vector<file_extent> &res) {
+    res.assign(i.ext, i.ext + min<size_t>(i.ext_count, inline_extents));
+    if (i.ext_count <= inline_extents)
         return;
+    const data_block& blk = get_block(i.ext_block);
+    res.resize(i.ext_count);
+    memcpy(&res[inline_extents], blk.arr, (i.ext_count - inline_extents) * sizeof(file_extent));
+}
+
+void file_system::store_extents(size_t ino, const std::vector<file_extent> &ext) {
+    inode& in = inodes[ino];
+    if (ext.size() > inline_extents + block_size_byte / sizeof(file_extent))
+        throw length_error("File is too fragmented.");
+    in.ext_count = ext.size();
+    copy(ext.begin(), ext.begin() + min(ext.size(), inline_extents), in.ext);
+    if (ext.size() > inline_extents) {
+        // the extents that don't fit in the i-node go to the extent block
+        if (in.ext_block == 0)
+            in.ext_block = get_free_block(ext.back().pblk + ext.back().len);
+        data_block blk(pool);
+        blk.bno = in.ext_block;
+        memcpy(blk.arr, &ext[inline_extents], (ext.size() - inline_extents) * sizeof(file_extent));
+        write_block(blk);
+    }
+    else if (in.ext_block != 0) {
+        put_free_block(in.ext_block);
+        in.ext_block = 0;
+    }
+    write_inode(ino);
+}
+
+size_t file_system::extent_bmap(const inode &i, size_t lblk) {
+    for (size_t k = 0; k < min<size_t>(i.ext_count, inline_extents); ++k) {
+        if (lblk >= i.ext[k].lblk && lblk - i.ext[k].lblk < i.ext[k].len)
+            return i.ext[k].pblk + (lblk - i.ext[k].lblk);
+    }
+    if (i.ext_count <= inline_extents)
+        return 0;
+    // binary search over the sorted extents of the extent block
+    const data_block& blk = get_block(i.ext_block);
+    size_t lo = 0, hi = i.ext_count - inline_extents;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        file_extent e;
+        memcpy(&e, blk.arr + mid * sizeof(file_extent), sizeof(file_extent));
+        if (lblk < e.lblk)
+            hi = mid;
+        else if (lblk - e.lblk >= e.len)
+            lo = mid + 1;
+        else
+            return e.pblk + (lblk - e.lblk);
+    }
+    return 0;
+}
+
+size_t file_system::extent_alloc(uint16_t ino, size_t lblk) {
+    size_t bno = extent_bmap(inodes[ino], lblk);
+    if (bno != 0)
+        return bno;
+    vector<file_extent> ext;
+    load_extents(inodes[ino], ext);
+    // extent after the new block
+    size_t pos = 0;
+    while (pos < ext.size() && ext[pos].lblk < lblk)
+        pos++;
+    // the new block is searched where the extent before it would continue
+    size_t hint = block_hint(ino);
+    if (pos > 0)
+        hint = ext[pos - 1].pblk + (lblk - ext[pos - 1].lblk);
+    bno = get_free_block(hint);
+    if (pos > 0 && ext[pos - 1].lblk + ext[pos - 1].len == lblk && ext[pos - 1].pblk + ext[pos - 1].len == bno)
+        ext[pos - 1].len++;
+    else
+        ext.insert(ext.begin() + pos, file_extent{(uint32_t) lblk, (uint32_t) bno, 1});
+    store_extents(ino, ext);
+    return bno;
+}
+
+void file_system::ra_start(readahead &ra, const inode &i) {
+    ra.in = i;
+    ra.size = get_inode_size(i);
+    ra.block_count = (size_t) ceil((double)ra.size / (double)block_size_byte);
+    ra.next = 0;
+    ra.ra_end = 0;
+    ra.window = min(ra_initial_window, ra_max_window());
+    ra.cluster.clear();
+}
+
+data_block file_system::ra_next(readahead &ra) {
+    if (ra.next >= ra.block_count)
+        throw range_error("Read is beyond the end of the file.");
+    // when the consumer reaches the second half of the window the next one is read
+    if (ra.window > 0 && ra.ra_end < ra.block_count && ra.next + ra.window / 2 >= ra.ra_end) {
+        size_t start = max(ra.ra_end, ra.next);
+        size_t end = min(ra.block_count, start + ra.window);
+        vector<size_t> bnos;
+        for (size_t l = start; l < end; ++l) {
+            size_t bno = bmap(ra.in, l);
+            if (bno != 0 && bno != compressed_block)
+                bnos.push_back(bno);
+        }
+        prefetch(bnos);
+        ra.ra_end = end;
+        // sequential access, grow the window
+        ra.window = min(2 * ra.window, ra_max_window());
+        ra_max_used = max(ra_max_used, ra.window);
+    }
+    size_t lblk = ra.next++;
+    // the contents are in the copy of the i-node
+    if (ra.in.flags & inode_inline_data)
+        return data_block::view_of(ra.in.inline_data, ra.size, block_size_byte, 0);
+    size_t size = (lblk + 1 == ra.block_count) ? ra.size - lblk * block_size_byte : block_size_byte;
+    if (ra.in.flags & inode_compressed) {
+        // the cluster is decompressed once for all of its blocks
+        size_t c = lblk / sb.cluster_blocks;
+        if (ra.cluster.empty() || ra.cluster_no != c) {
+            load_cluster(ra.in, c, ra.cluster);
+            ra.cluster_no = c;
+        }
+        char* arr = ra.cluster.data() + (lblk % sb.cluster_blocks) * block_size_byte;
+        return data_block::view_of(arr, size, block_size_byte, 0);
+    }
+    size_t bno = bmap(ra.in, lblk);
+    if (bno == 0) {
+        if (hole_block.size() != block_size_byte)
+            hole_block.assign(block_size_byte, 0);
+        return data_block::view_of(hole_block.data(), size, block_size_byte, 0);
+    }
+    // prefetched blocks are verified when they are consumed, the table block is read first
+    bool unverified = has_feature(feature_metadata_csum) && !csum_verified[bno];
+    uint32_t sum = unverified ? load_csum(bno) : 0;
+    // consumed blocks stay behind the prefetched ones in the LRU order
+    const data_block* cached = cache.peek(bno);
+    char* mapped = dev.map_block(bno);
+    if (cached == nullptr && mapped != nullptr) {
+        if (unverified)
+            check_csum(bno, mapped, sum);
+        return data_block::view_of(mapped, size, block_size_byte, bno);
+    }
+    const data_block& blk = (cached != nullptr) ? *cached : cache.get(bno);
+    if (unverified)
+        check_csum(bno, blk.arr, sum);
+    // valid until the cache is changed again
+    return data_block::view_of(blk.arr, size, block_size_byte, bno);
+}
+
+void file_system::prefetch(const std::vector<size_t> &bnos) {
+    ra_blocks += bnos.size();
+    if (dev.map_block(0) != nullptr)
+        dev.will_need(bnos);
+    else
+        cache.prefetch(bnos);
+}
+
+size_t file_system::ra_max_window() const {
+    return min(ra_window_limit, cache.get_capacity() / 2);
 }
 
 void file_system::load_by_block_no(size_t bno, size_t size = 0) {
-    ifstream file(filename,ios::binary| ios::in);
-    file.exceptions ( std::ios::failbit | std::ios::badbit );
-    file.seekg(bno*block_size_byte);
-    char* temp = new char[block_size_byte];
-    file.read(temp, block_size_byte);
-    file.close();
-    data_block res(temp, size, block_size_byte, bno);
-    temp_blocks.emplace_back(res);
-    delete[] temp;
+    // the only copy of the block, its buffer comes from the pool
+    temp_blocks.emplace_back(get_block(bno));
+    temp_blocks.back().size = size;
 }
 
-void file_system::write_block(const data_block& b) const
+void file_system::write_block(const data_block& b, bool data)
 {
-    ofstream file(filename,ios::binary| ios::out | ios::in);
-    file.exceptions ( std::ios::failbit | std::ios::badbit );
-    file.seekp(b.bno*block_size_byte);
-    file.write((char *)b.arr, block_size_byte);
-    file.close();
+    if (has_feature(data ? feature_data_csum : feature_metadata_csum)) {
+        store_csum(b.bno, crc32c::of(b.arr, block_size_byte));
+        csum_verified[b.bno] = true;
+    }
+    // a data block in a block that was logged before has to replace its copy in the log
+    bool logged = jrnl.is_open() && (!data || dev.is_remapped(b.bno));
+    // the block may have been freed by a transaction that isn't durable yet, a crash
+    // would give it back to its old owner, so it is overwritten in place after the sync
+    if (!logged && jrnl.is_open() && jrnl.has_unsynced_frees())
+        jrnl.sync();
+    cache.put(b, logged);
 }
 
-void file_system::write_superblock()
+void file_system::write_block(size_t bno, const char *arr, bool data)
 {
-    ofstream file(filename, ios::binary | ios::out | ios::in );
-    file.exceptions ( std::ios::failbit | std::ios::badbit );
-    file.write((char *)&sb, sizeof(sb));
-    file.close();
+    // the cache copies the bytes of the view
+    write_block(data_block::view_of(const_cast<char*>(arr), block_size_byte, block_size_byte, bno), data);
 }
 
-void file_system::write_inode(uint16_t ino)
+const data_block &file_system::get_block(size_t bno)
 {
-    // find which block ino is in
-    size_t ino_addr = ino*sizeof(inode) + sb.inode_pos * block_size_byte;
-    fstream file(filename, ios::binary| ios::out | ios::in);
-    file.exceptions ( std::ios::failbit | std::ios::badbit );
-    file.seekp(ino_addr);
-    file.write((char *)&inodes[ino],sizeof(inode));
-    file.close();
+    if (has_feature(feature_metadata_csum) && !csum_verified[bno]) {
+        // the table block is read first, reading it could evict the block
+        uint32_t sum = load_csum(bno);
+        check_csum(bno, cache.get(bno).arr, sum);
+    }
+    return cache.get(bno);
 }
 
-uint32_t file_system::get_inode_size(const inode& i) {
-    return i.size;
+void file_system::check_csum(size_t bno, const char *arr, uint32_t sum)
+{
+    if (sum != 0 && crc32c::of(arr, block_size_byte) != sum)
+        throw runtime_error("Checksum of block " + to_string(bno) + " doesn't match.");
+    csum_verified[bno] = true;
 }
 
-void file_system::load_inode_blocks_helper(size_t bno, size_t* size, size_t* rem_blocks, size_t level) {
-    if (*rem_blocks == 0) {
+uint32_t file_system::load_csum(size_t bno)
+{
+    size_t blk, off;
+    csum_record_pos(bno, blk, off);
+    uint32_t sum;
+    memcpy(&sum, cache.get(blk).arr + off, sizeof(sum));
+    return sum;
+}
+
+void file_system::store_csum(size_t bno, uint32_t sum)
+{
+    // the blocks of the table don't have checksums themselves
+    size_t blk, off;
+    csum_record_pos(bno, blk, off);
+    data_block temp(cache.get(blk));
+    memcpy(temp.arr + off, &sum, sizeof(sum));
+    cache.put(temp, jrnl.is_open());
+}
+
+void file_system::csum_record_pos(size_t bno, size_t &blk, size_t &off) const
+{
+    if (groups.empty()) {
+        blk = sb.csum_pos + bno * sizeof(uint32_t) / block_size_byte;
+        off = bno * sizeof(uint32_t) % block_size_byte;
         return;
     }
-    if (level == 0) {
-        if (*rem_blocks == 0) {
-            load_by_block_no(bno, *size);
-            inode_blocks.push_back(temp_blocks.back());
-            temp_blocks.pop_back();
-            *rem_blocks = 0;
-            *size = 0;
-            return;
-        }
-        load_by_block_no(bno, block_size_byte);
-        inode_blocks.push_back(temp_blocks.back());
+    size_t g = bno / sb.blocks_per_group;
+    size_t i = bno % sb.blocks_per_group;
+    blk = group_data_start(g) - csum_group_blocks() + i * sizeof(uint32_t) / block_size_byte;
+    off = i * sizeof(uint32_t) % block_size_byte;
+}
+
+size_t file_system::csum_group_blocks() const
+{
+    if (!has_feature(feature_metadata_csum))
+        return 0;
+    return (sb.blocks_per_group * sizeof(uint32_t) + block_size_byte - 1) / block_size_byte;
+}
+
+void file_system::verify_metadata()
+{
+    vector<size_t> bnos;
+    size_t sb_blocks = groups.empty() ? 1 : gdt_blocks();
+    for (size_t i = 0; i < sb_blocks; ++i)
+        bnos.push_back(i);
+    for (size_t i = 0; i < inode_table_blocks(); ++i)
+        bnos.push_back(itable_block_no(i));
+    for (size_t i = 0; i < bitmap.block_count(); ++i)
+        bnos.push_back(bitmap_block_no(i));
+    // read in batches that fit in the cache
+    size_t batch = max<size_t>(1, cache.get_capacity() / 2);
+    for (size_t first = 0; first < bnos.size(); first += batch) {
+        vector<size_t> part(bnos.begin() + first, bnos.begin() + min(bnos.size(), first + batch));
+        cache.prefetch(part);
+        for (auto bno : part)
+            get_block(bno);
+    }
+}
+
+void file_system::write_superblock()
+{
+    // written once when the operation ends
+    sb_dirty = true;
+}
+
+void file_system::write_inode(uint16_t ino)
+{
+    // find which block ino is in, it is written once when the operation ends
+    itable_dirty[ino * inode_size / block_size_byte] = true;
+}
+
+void file_system::flush_metadata()
+{
+    for (size_t i = 0; i < itable_dirty.size(); ++i) {
+        if (!itable_dirty[i])
+            continue;
+        size_t first = i * block_size_byte / inode_size;
+        size_t count = min(block_size_byte / inode_size, inodes.size() - first);
+        load_by_block_no(itable_block_no(i));
+        data_block& blk = temp_blocks.back();
+        for (size_t k = 0; k < count; ++k)
+            encode_inode(inodes[first + k], blk.arr + k * inode_size);
+        write_block(blk);
         temp_blocks.pop_back();
-        *size -= block_size_byte;
-        *rem_blocks -= 1;
+        itable_dirty[i] = false;
+    }
+    for (size_t i = 0; i < bitmap.block_count(); ++i) {
+        if (!bitmap.is_dirty(i))
+            continue;
+        load_by_block_no(bitmap_block_no(i));
+        data_block& blk = temp_blocks.back();
+        memcpy(blk.arr, bitmap.block_bytes(i), bitmap.bytes_per_block());
+        write_block(blk);
+        temp_blocks.pop_back();
+        bitmap.clean(i);
+    }
+    if (sb_dirty) {
+        // group counters change with the superblock
+        write_superblock_blocks();
+        sb_dirty = false;
+    }
+}
+
+bool file_system::has_feature(uint32_t feature) const {
+    return (sb.features & feature) != 0;
+}
+
+void file_system::decode_superblock(const char *arr) {
+    disk_superblock d;
+    memcpy(&d, arr, sizeof(d));
+    // older images have garbage after the first fields
+    if (d.magic != sb_magic)
+        memset((char*)&d + v1_superblock_size, 0, sizeof(d) - v1_superblock_size);
+    sb.block_size = d.block_size;
+    sb.root_dir_address = d.root_dir_address;
+    sb.inode_pos = d.inode_pos;
+    sb.inode_count = d.inode_count;
+    sb.free_inode_count = d.free_inode_count;
+    sb.fb_count = d.fb_count;
+    sb.fb_head = d.fb_head;
+    sb.fb_tail = d.fb_tail;
+    sb.magic = d.magic;
+    sb.features = d.features;
+    sb.bitmap_pos = d.bitmap_pos;
+    sb.bitmap_blocks = d.bitmap_blocks;
+    sb.group_count = d.group_count;
+    sb.blocks_per_group = d.blocks_per_group;
+    sb.inodes_per_group = d.inodes_per_group;
+    sb.cluster_blocks = d.cluster_blocks;
+    sb.block_count = KB / sb.block_size;
+    if (has_feature(feature_v2)) {
+        sb.block_count = d.wide.block_count;
+        sb.fb_count = d.wide.fb_count;
+        sb.root_dir_address = d.wide.root_dir_address;
+        sb.inode_pos = d.wide.inode_pos;
+        sb.inode_count = d.wide.inode_count;
+        sb.free_inode_count = d.wide.free_inode_count;
+        sb.dedup_pos = d.dedup_pos;
+        sb.dedup_blocks = d.dedup_blocks;
+        sb.csum_pos = d.csum_pos;
+        sb.csum_blocks = d.csum_blocks;
+        sb.journal_pos = d.journal_pos;
+        sb.journal_blocks = d.journal_blocks;
     }
     else {
-        load_by_block_no(bno, block_size_byte);
-        data_block temp = temp_blocks.back();
-        temp_blocks.pop_back();
-        for (size_t i = 0; i < block_cap && *rem_blocks > 0; ++i) {
-            load_inode_blocks_helper(temp.get_address(i), size, rem_blocks, level - 1);
+        sb.dedup_pos = 0;
+        sb.dedup_blocks = 0;
+        sb.csum_pos = 0;
+        sb.csum_blocks = 0;
+        sb.journal_pos = 0;
+        sb.journal_blocks = 0;
+    }
+    if (has_feature(feature_metadata_csum)) {
+        uint32_t sum = d.checksum;
+        d.checksum = 0;
+        if (crc32c::of((const char*) &d, sizeof(d)) != sum)
+            throw runtime_error("Superblock checksum doesn't match.");
+    }
+}
+
+void file_system::encode_superblock(char *arr) const {
+    disk_superblock d;
+    memset(&d, 0, sizeof(d));
+    d.block_size = sb.block_size;
+    d.root_dir_address = sb.root_dir_address;
+    d.inode_pos = sb.inode_pos;
+    d.inode_count = sb.inode_count;
+    d.free_inode_count = sb.free_inode_count;
+    d.fb_count = sb.fb_count;
+    d.fb_head = sb.fb_head;
+    d.fb_tail = sb.fb_tail;
+    d.magic = sb.magic;
+    d.features = sb.features;
+    d.bitmap_pos = sb.bitmap_pos;
+    d.bitmap_blocks = sb.bitmap_blocks;
+    d.group_count = sb.group_count;
+    d.blocks_per_group = sb.blocks_per_group;
+    d.inodes_per_group = sb.inodes_per_group;
+    d.cluster_blocks = sb.cluster_blocks;
+    d.wide.block_count = sb.block_count;
+    d.wide.fb_count = sb.fb_count;
+    d.wide.root_dir_address = sb.root_dir_address;
+    d.wide.inode_pos = sb.inode_pos;
+    d.wide.inode_count = sb.inode_count;
+    d.wide.free_inode_count = sb.free_inode_count;
+    d.dedup_pos = sb.dedup_pos;
+    d.dedup_blocks = sb.dedup_blocks;
+    d.csum_pos = sb.csum_pos;
+    d.csum_blocks = sb.csum_blocks;
+    d.journal_pos = sb.journal_pos;
+    d.journal_blocks = sb.journal_blocks;
+    if (has_feature(feature_metadata_csum))
+        d.checksum = crc32c::of((const char*) &d, sizeof(d));
+    // older images keep whatever follows the fields they have
+    memcpy(arr, &d, superblock_size());
+}
+
+void file_system::decode_inode(const char *arr, inode &in) const {
+    if (has_feature(feature_v2)) {
+        disk_inode_v2 d;
+        memcpy(&d, arr, sizeof(d));
+        in.year = d.year;
+        in.month = d.month;
+        in.day = d.day;
+        in.hour = d.hour;
+        in.min = d.min;
+        in.sec = d.sec;
+        in.size = d.size;
+        in.type = d.type;
+        in.link_count = d.link_count;
+        in.flags = d.flags;
+        // indexed directories are mapped with blocks, the index comes after them
+        in.index_block = (in.flags & inode_dir_index) ? d.map.blocks.index : 0;
+        if (in.flags & inode_inline_data) {
+            memcpy(in.inline_data, arr + offsetof(disk_inode_v2, map), inline_capacity());
+            return;
+        }
+        if (in.flags & inode_extents) {
+            in.ext_count = d.map.extents.count;
+            copy(d.map.extents.ext, d.map.extents.ext + inline_extents, in.ext);
+            in.ext_block = d.map.extents.block;
+            return;
         }
+        copy(d.map.blocks.ba, d.map.blocks.ba + direct_count, in.ba);
+        in.si = d.map.blocks.si;
+        in.di = d.map.blocks.di;
+        in.ti = d.map.blocks.ti;
+        return;
+    }
+    disk_inode_v1 d;
+    memcpy(&d, arr, sizeof(d));
+    in.year = d.year;
+    in.month = d.month;
+    in.day = d.day;
+    in.hour = d.hour;
+    in.min = d.min;
+    in.sec = d.sec;
+    in.size = d.size;
+    in.type = d.type;
+    in.link_count = d.link_count;
+    in.flags = 0;
+    copy(d.ba, d.ba + direct_count, in.ba);
+    in.si = d.si;
+    in.di = d.di;
+    in.ti = d.ti;
+}
+
+void file_system::encode_inode(const inode &in, char *arr) const {
+    if (has_feature(feature_v2)) {
+        disk_inode_v2 d;
+        memset(&d, 0, sizeof(d));
+        d.year = in.year;
+        d.month = in.month;
+        d.day = in.day;
+        d.hour = in.hour;
+        d.min = in.min;
+        d.sec = in.sec;
+        d.size = in.size;
+        d.type = in.type;
+        d.link_count = in.link_count;
+        d.flags = in.flags;
+        if (in.flags & inode_extents) {
+            d.map.extents.count = in.ext_count;
+            copy(in.ext, in.ext + inline_extents, d.map.extents.ext);
+            d.map.extents.block = in.ext_block;
+        }
+        else {
+            copy(in.ba, in.ba + direct_count, d.map.blocks.ba);
+            d.map.blocks.si = in.si;
+            d.map.blocks.di = in.di;
+            d.map.blocks.ti = in.ti;
+            d.map.blocks.index = in.index_block;
+        }
+        memcpy(arr, &d, sizeof(d));
+        memset(arr + sizeof(d), 0, inode_size - sizeof(d));
+        if (in.flags & inode_inline_data)
+            memcpy(arr + offsetof(disk_inode_v2, map), in.inline_data, inline_capacity());
+        return;
+    }
+    disk_inode_v1 d;
+    memset(&d, 0, sizeof(d));
+    d.year = in.year;
+    d.month = in.month;
+    d.day = in.day;
+    d.hour = in.hour;
+    d.min = in.min;
+    d.sec = in.sec;
+    d.size = in.size;
+    d.type = in.type;
+    d.link_count = in.link_count;
+    copy(in.ba, in.ba + direct_count, d.ba);
+    d.si = in.si;
+    d.di = in.di;
+    d.ti = in.ti;
+    memcpy(arr, &d, sizeof(d));
+}
+
+void file_system::write_superblock_blocks() {
+    if (groups.empty()) {
+        load_by_block_no(0);
+        data_block& blk = temp_blocks.back();
+        encode_superblock(blk.arr);
+        write_block(blk);
+        temp_blocks.pop_back();
+        return;
+    }
+    // the group descriptor table may continue after block 0
+    vector<char> region(gdt_blocks() * block_size_byte, 0);
+    encode_superblock(region.data());
+    memcpy(region.data() + gdt_offset, groups.data(), groups.size() * sizeof(group_desc));
+    for (size_t i = 0; i < gdt_blocks(); ++i) {
+        data_block blk(region.data() + i * block_size_byte, block_size_byte, block_size_byte, i);
+        write_block(blk);
+    }
+}
+
+size_t file_system::gdt_blocks() const {
+    return (gdt_offset + groups.size() * sizeof(group_desc) + block_size_byte - 1) / block_size_byte;
+}
+
+size_t file_system::superblock_size() const {
+    if (has_feature(feature_v2))
+        return sizeof(disk_superblock);
+    return sb.magic == sb_magic ? offsetof(disk_superblock, wide) : v1_superblock_size;
+}
+
+uint64_t file_system::max_file_size() const {
+    if (!has_feature(feature_v2))
+        return v1_max_file_size;
+    // an extent can map any block of the image
+    if (has_feature(feature_extents))
+        return (uint64_t) sb.block_count * block_size_byte;
+    // as much as the block addresses of an i-node can map
+    uint64_t blocks = direct_count + block_cap + (uint64_t) block_cap * block_cap
+                      + (uint64_t) block_cap * block_cap * block_cap;
+    return min<uint64_t>(blocks, sb.block_count) * block_size_byte;
+}
+
+size_t file_system::total_block_count() const {
+    return sb.block_count;
+}
+
+size_t file_system::inode_table_blocks() const {
+    return (sb.inode_count * inode_size + block_size_byte - 1) / block_size_byte;
+}
+
+size_t file_system::itable_block_no(size_t i) const {
+    if (groups.empty())
+        return sb.inode_pos + i;
+    size_t per_group = sb.inodes_per_group * inode_size / block_size_byte;
+    return groups[i / per_group].inode_table + i % per_group;
+}
+
+size_t file_system::bitmap_block_no(size_t i) const {
+    return groups.empty() ? sb.bitmap_pos + i : groups[i].bitmap_pos;
+}
+
+size_t file_system::group_data_start(size_t g) const {
+    size_t first_inode = min<size_t>(g * sb.inodes_per_group, sb.inode_count);
+    size_t inode_count = min<size_t>(sb.inodes_per_group, sb.inode_count - first_inode);
+    return groups[g].inode_table + (inode_count * inode_size + block_size_byte - 1) / block_size_byte
+           + csum_group_blocks();
+}
+
+size_t file_system::block_hint(size_t ino) const {
+    // data of a file is kept in the group of its inode
+    if (groups.empty())
+        return alloc_hint;
+    return groups[ino / sb.inodes_per_group].first_block;
+}
+
+size_t file_system::dir_inode_hint(size_t parent) const {
+    if (groups.empty())
+        return parent;
+    // the group with the most free blocks among the ones with enough free inodes
+    size_t avg_inodes = sb.free_inode_count / groups.size();
+    size_t best = parent / sb.inodes_per_group;
+    for (size_t g = 0; g < groups.size(); ++g) {
+        if (groups[g].free_inodes == 0 || groups[g].free_inodes < avg_inodes)
+            continue;
+        if (groups[best].free_inodes == 0 || groups[g].free_blocks > groups[best].free_blocks)
+            best = g;
     }
+    return best * sb.inodes_per_group;
+}
+
+uint64_t file_system::get_inode_size(const inode& i) {
+    return i.size;
 }
 
 void file_system::mkdir(const std::string& arg) {
@@ -355,219 +1360,623 @@ void file_system::mkdir(const std::string& arg) {
     string name,path;
     // check the parameter
     new_file_args(arg, path, name, parent);
-    //get free inode
-    uint16_t newi = get_free_inode();
+    //get free inode, directories are spread over the groups
+    uint16_t newi = get_free_inode(dir_inode_hint(parent));
     init_inode(newi);
-    data_block temp(block_size_byte);
+    data_block temp(pool);
     init_directory(temp,newi,parent);
-    write(newi,0,data_block::dir_entry_size*2,temp.arr);
-    vector<char> dir_ent = create_dir_entry(newi,name);
+    write(newi,0,empty_dir_size(),temp.arr);
     //write the data blocks
-    uint32_t pos = get_inode_size(inodes[parent]);
-    write(parent,pos,data_block::dir_entry_size,dir_ent.data());
+    add_dir_entry(parent,newi,name);
     set_inode_time(parent);
-    add_inode_size(parent,data_block::dir_entry_size);
     write_inode(newi);
     write_inode(parent);
+    sync();
 }
 
-void file_system::write(uint16_t inode_index, uint32_t pos, uint32_t size,const char* buf)
+void file_system::write(uint16_t inode_index, uint64_t pos, uint64_t size,const char* buf)
 {
     //cursor for the buffer
     size_t buf_pos = 0;
-    inode & in = inodes[inode_index];
-    // store the remaining block to write the remainder to a block specially
-    size_t cur_block;
-    size_t file_size = get_inode_size(inodes[inode_index]);
-    if(file_size >= max_file_size)
+    uint64_t file_size = get_inode_size(inodes[inode_index]);
+    if(file_size >= max_file_size())
         throw std::runtime_error("File is too large.");
-    if(pos > file_size){
+    // the bytes before pos are a hole in sparse files
+    if(pos > file_size && !has_feature(feature_sparse)){
         throw std::runtime_error("File point cannot be greater than size.");
     }
-    size_t off_di = block_cap*block_size_byte + direct_count*block_size_byte;
-    size_t off_ti = off_di + block_cap*block_cap*block_size_byte;
-    if((pos >> (10 + sb.block_size)) < direct_count+1){
-        cur_block = pos >> (10 + sb.block_size);
-    }
-        // if it starts from double indirect
-    else if( (pos >= off_di) && (pos - off_di) <
-                                (block_cap*block_cap*block_size_byte))
-    {
-        cur_block = direct_count;
+    inode & in = inodes[inode_index];
+    if (in.flags & inode_inline_data) {
+        // directories are always kept in blocks
+        if (in.type != dir_type && pos + size <= inline_capacity()) {
+            if (pos > file_size)
+                memset(in.inline_data + file_size, 0, pos - file_size);
+            memcpy(in.inline_data + pos, buf, size);
+            write_inode(inode_index);
+            return;
+        }
+        move_inline_data(inode_index, min(pos, file_size));
     }
-        // if it starts from triple indirect
-    else if((pos >= off_ti) && (pos - off_ti)  <
-                               (block_cap*block_cap*block_cap*block_size_byte))
-    {
-        cur_block = direct_count+1;
+    if (in.flags & inode_compressed) {
+        write_clusters(inode_index, pos, size, buf);
+        write_inode(inode_index);
+        write_superblock();
+        return;
     }
-    else{
-        throw runtime_error("Position is too large.");
+    if (in.flags & inode_dedup) {
+        write_dedup(inode_index, pos, size, buf);
+        write_inode(inode_index);
+        write_superblock();
+        return;
     }
     // block by block operation
-    for (; cur_block < direct_count && size > 0; cur_block++){
-        // if there are no blocks allocated yet
-        if(in.ba[cur_block] == 0){
-            //will write the inode later
-            in.ba[cur_block] = get_free_block();
+    while (size > 0) {
+        size_t off = pos % block_size_byte;
+        size_t len = min<uint64_t>(block_size_byte - off, size);
+        // zeros written over a hole don't take a block
+        if (has_feature(feature_sparse) && is_zero(buf + buf_pos, len) && bmap(in, pos / block_size_byte) == 0) {
+            buf_pos += len;
+            pos += len;
+            size -= len;
+            continue;
+        }
+        size_t bno = bmap_alloc(inode_index, pos / block_size_byte);
+        // a block that is overwritten completely doesn't have to be read, it goes from buf to the cache
+        if (len == block_size_byte) {
+            write_block(bno, buf + buf_pos, in.type != dir_type);
+        }
+        else {
+            load_by_block_no(bno);
+            data_block & temp = temp_blocks.back();
+            memcpy(temp.arr + off, buf + buf_pos, len);
+            // the cache writes it back later, directory blocks are metadata
+            write_block(temp, in.type != dir_type);
+            temp_blocks.pop_back();
+        }
+        buf_pos += len;
+        pos += len;
+        size -= len;
+    }
+    //will write the inode later
+    write_inode(inode_index);
+    write_superblock();
+}
+
+void file_system::move_inline_data(uint16_t ino, size_t keep)
+{
+    inode & in = inodes[ino];
+    vector<char> data(in.inline_data, in.inline_data + min(keep, inline_capacity()));
+    in.flags &= ~inode_inline_data;
+    memset(in.inline_data, 0, sizeof(in.inline_data));
+    if (!data.empty())
+        write(ino, 0, data.size(), data.data());
+    write_inode(ino);
+}
+
+uint16_t file_system::new_inode_flags() const
+{
+    uint16_t flags = 0;
+    if (has_feature(feature_extents))
+        flags |= inode_extents;
+    if (has_feature(feature_inline_data))
+        flags |= inode_inline_data;
+    return flags;
+}
+
+size_t file_system::inline_capacity() const
+{
+    return inode_size - offsetof(disk_inode_v2, map);
+}
+
+size_t file_system::bmap_alloc(uint16_t ino, size_t lblk)
+{
+    inode & in = inodes[ino];
+    if (in.flags & inode_extents)
+        return extent_alloc(ino, lblk);
+    size_t path[3];
+    size_t levels = indirect_path(lblk, path);
+    if (levels == 0) {
+        // if there are no blocks allocated yet, blocks of the file are kept together
+        if (in.ba[lblk] == 0) {
+            if (lblk > 0 && in.ba[lblk - 1] != 0)
+                in.ba[lblk] = get_free_block(in.ba[lblk - 1] + 1);
+            else
+                in.ba[lblk] = get_free_block(block_hint(ino));
+        }
+        return in.ba[lblk];
+    }
+    uint32_t* roots[] = {&in.si, &in.di, &in.ti};
+    return indirect_alloc(*roots[levels - 1], path, levels);
+}
+
+size_t file_system::indirect_path(size_t lblk, size_t *path) const
+{
+    if (lblk < direct_count) {
+        path[0] = lblk;
+        return 0;
+    }
+    lblk -= direct_count;
+    if (lblk < block_cap) {
+        path[0] = lblk;
+        return 1;
+    }
+    lblk -= block_cap;
+    if (lblk < block_cap * block_cap) {
+        path[0] = lblk / block_cap;
+        path[1] = lblk % block_cap;
+        return 2;
+    }
+    lblk -= block_cap * block_cap;
+    if (lblk < block_cap * block_cap * block_cap) {
+        path[0] = lblk / (block_cap * block_cap);
+        path[1] = (lblk / block_cap) % block_cap;
+        path[2] = lblk % block_cap;
+        return 3;
+    }
+    throw runtime_error("Position is too large.");
+}
+
+void file_system::bmap_set(uint16_t ino, size_t lblk, size_t addr)
+{
+    inode & in = inodes[ino];
+    size_t path[3];
+    size_t levels = indirect_path(lblk, path);
+    if (levels == 0) {
+        in.ba[lblk] = addr;
+        return;
+    }
+    uint32_t* roots[] = {&in.si, &in.di, &in.ti};
+    indirect_alloc(*roots[levels - 1], path, levels, addr);
+}
+
+void file_system::write_clusters(uint16_t ino, uint64_t pos, uint64_t size, const char *buf)
+{
+    size_t cluster_bytes = sb.cluster_blocks * block_size_byte;
+    uint64_t end = max<uint64_t>(get_inode_size(inodes[ino]), pos + size);
+    size_t end_blocks = (end + block_size_byte - 1) / block_size_byte;
+    vector<char> cluster;
+    while (size > 0) {
+        size_t c = pos / cluster_bytes;
+        size_t off = pos % cluster_bytes;
+        size_t len = min<uint64_t>(cluster_bytes - off, size);
+        size_t valid = min<size_t>(sb.cluster_blocks, end_blocks - c * sb.cluster_blocks);
+        // a cluster that is overwritten completely doesn't have to be read
+        if (len == cluster_bytes) {
+            store_cluster(ino, c, buf, valid);
+        }
+        else {
+            load_cluster(inodes[ino], c, cluster);
+            memcpy(cluster.data() + off, buf, len);
+            store_cluster(ino, c, cluster.data(), valid);
+        }
+        buf += len;
+        pos += len;
+        size -= len;
+    }
+}
+
+void file_system::store_cluster(uint16_t ino, size_t cluster, const char *data, size_t valid)
+{
+    size_t first = cluster * sb.cluster_blocks;
+    unmap_blocks(ino, first, first + sb.cluster_blocks);
+    if (has_feature(feature_sparse) && is_zero(data, valid * block_size_byte))
+        return;
+    // compressed only if it saves at least one block
+    vector<char> packed(valid * block_size_byte, 0);
+    size_t len = 0;
+    if (valid > 1)
+        len = lz4_codec::compress(data, valid * block_size_byte, packed.data() + cluster_header,
+                                  (valid - 1) * block_size_byte - cluster_header);
+    size_t count = valid;
+    if (len != 0) {
+        for (size_t i = 0; i < cluster_header; ++i)
+            packed[i] = (char) (len >> (8 * (cluster_header - 1 - i)));
+        count = (cluster_header + len + block_size_byte - 1) / block_size_byte;
+        data = packed.data();
+    }
+    for (size_t j = 0; j < count; ++j) {
+        if (len == 0 && has_feature(feature_sparse) && is_zero(data + j * block_size_byte, block_size_byte))
+            continue;
+        write_block(bmap_alloc(ino, first + j), data + j * block_size_byte, true);
+    }
+    if (len != 0) {
+        for (size_t j = count; j < sb.cluster_blocks; ++j)
+            bmap_set(ino, first + j, compressed_block);
+    }
+}
+
+void file_system::load_cluster(const inode &in, size_t cluster, std::vector<char> &res)
+{
+    size_t first = cluster * sb.cluster_blocks;
+    res.assign(sb.cluster_blocks * block_size_byte, 0);
+    vector<size_t> bnos;
+    for (size_t j = 0; j < sb.cluster_blocks; ++j)
+        bnos.push_back(bmap(in, first + j));
+    if (bnos.back() != compressed_block) {
+        for (size_t j = 0; j < bnos.size(); ++j) {
+            if (bnos[j] != 0)
+                memcpy(res.data() + j * block_size_byte, get_block(bnos[j]).arr, block_size_byte);
         }
-        load_by_block_no(in.ba[cur_block]);
-        data_block & temp = temp_blocks.back();
+        return;
+    }
+    vector<char> packed;
+    for (size_t j = 0; bnos[j] != compressed_block; ++j) {
+        const data_block& blk = get_block(bnos[j]);
+        packed.insert(packed.end(), blk.arr, blk.arr + block_size_byte);
+    }
+    size_t len = 0;
+    for (size_t i = 0; i < cluster_header && i < packed.size(); ++i)
+        len = (len << 8) + (uint8_t) packed[i];
+    if (packed.size() < cluster_header || len > packed.size() - cluster_header)
+        throw logic_error("Compressed cluster is corrupted.");
+    lz4_codec::decompress(packed.data() + cluster_header, len, res.data(), res.size());
+}
 
-        // assign the buf to the block
-        for (size_t i = pos % block_size_byte; i < block_size_byte && size > 0 ; ++i, ++pos){
-            temp.arr[i] = buf[buf_pos++];
-            size--;
+void file_system::write_dedup(uint16_t ino, uint64_t pos, uint64_t size, const char *buf)
+{
+    vector<char> data(block_size_byte);
+    while (size > 0) {
+        size_t lblk = pos / block_size_byte;
+        size_t off = pos % block_size_byte;
+        size_t len = min<uint64_t>(block_size_byte - off, size);
+        size_t old = bmap(inodes[ino], lblk);
+        // the hash is of the whole block after the write
+        if (len != block_size_byte) {
+            if (old != 0)
+                memcpy(data.data(), get_block(old).arr, block_size_byte);
+            else
+                fill(data.begin(), data.end(), 0);
+        }
+        memcpy(data.data() + off, buf, len);
+        buf += len;
+        pos += len;
+        size -= len;
+        if (has_feature(feature_sparse) && is_zero(data.data(), block_size_byte)) {
+            if (old != 0)
+                unmap_blocks(ino, lblk, lblk + 1);
+            continue;
+        }
+        uint64_t hash = block_hash::of(data.data(), block_size_byte);
+        size_t same = dedup_find(data.data(), hash);
+        if (same != 0 && same == old)
+            continue;
+        if (same != 0) {
+            dedup_record rec = dedup_load(same);
+            rec.refs++;
+            dedup_store(same, rec);
+            bmap_set(ino, lblk, same);
+        }
+        else if (old != 0 && dedup_load(old).refs == 1) {
+            // a block only this one refers to is changed in place and moves to its new bucket
+            dedup_remove(old);
+            write_block(old, data.data(), true);
+            dedup_insert(old, hash);
+            continue;
+        }
+        else {
+            size_t bno = get_free_block();
+            write_block(bno, data.data(), true);
+            dedup_insert(bno, hash);
+            bmap_set(ino, lblk, bno);
+        }
+        if (old != 0)
+            free_data_block(old);
+    }
+}
+
+size_t file_system::dedup_find(const char *data, uint64_t hash)
+{
+    // block 0 is the superblock, so it ends the chains
+    for (size_t bno = dedup_bucket(hash); bno != 0;) {
+        dedup_record rec = dedup_load(bno);
+        if (rec.hash == hash && memcmp(get_block(bno).arr, data, block_size_byte) == 0)
+            return bno;
+        bno = rec.next;
+    }
+    return 0;
+}
+
+void file_system::dedup_insert(size_t bno, uint64_t hash)
+{
+    dedup_store(bno, dedup_record{1, (uint32_t) dedup_bucket(hash), hash});
+    set_dedup_bucket(hash, bno);
+}
+
+void file_system::dedup_remove(size_t bno)
+{
+    dedup_record rec = dedup_load(bno);
+    size_t prev = 0;
+    size_t cur = dedup_bucket(rec.hash);
+    while (cur != bno) {
+        if (cur == 0)
+            throw logic_error("Deduplication index is corrupted.");
+        prev = cur;
+        cur = dedup_load(cur).next;
+    }
+    if (prev == 0) {
+        set_dedup_bucket(rec.hash, rec.next);
+    }
+    else {
+        dedup_record prev_rec = dedup_load(prev);
+        prev_rec.next = rec.next;
+        dedup_store(prev, prev_rec);
+    }
+    dedup_store(bno, dedup_record{0, 0, 0});
+}
+
+dedup_record file_system::dedup_load(size_t bno)
+{
+    size_t blk, off;
+    dedup_record_pos(bno, blk, off);
+    dedup_record rec;
+    memcpy(&rec, get_block(blk).arr + off, sizeof(rec));
+    return rec;
+}
+
+void file_system::dedup_store(size_t bno, const dedup_record &rec)
+{
+    size_t blk, off;
+    dedup_record_pos(bno, blk, off);
+    load_by_block_no(blk);
+    data_block& temp = temp_blocks.back();
+    memcpy(temp.arr + off, &rec, sizeof(rec));
+    write_block(temp);
+    temp_blocks.pop_back();
+}
+
+size_t file_system::dedup_bucket(uint64_t hash)
+{
+    size_t i = hash & (dedup_bucket_count() - 1);
+    uint32_t head;
+    memcpy(&head, get_block(sb.dedup_pos + i * 4 / block_size_byte).arr + i * 4 % block_size_byte, 4);
+    return head;
+}
+
+void file_system::set_dedup_bucket(uint64_t hash, size_t head)
+{
+    size_t i = hash & (dedup_bucket_count() - 1);
+    uint32_t value = head;
+    load_by_block_no(sb.dedup_pos + i * 4 / block_size_byte);
+    data_block& temp = temp_blocks.back();
+    memcpy(temp.arr + i * 4 % block_size_byte, &value, 4);
+    write_block(temp);
+    temp_blocks.pop_back();
+}
+
+void file_system::dedup_record_pos(size_t bno, size_t &blk, size_t &off) const
+{
+    size_t bucket_blocks = (dedup_bucket_count() * 4 + block_size_byte - 1) / block_size_byte;
+    blk = sb.dedup_pos + bucket_blocks + bno * sizeof(dedup_record) / block_size_byte;
+    off = bno * sizeof(dedup_record) % block_size_byte;
+}
+
+size_t file_system::dedup_bucket_count() const
+{
+    // about two blocks a chain when every block is in the index
+    size_t count = 1;
+    while (count < sb.block_count / 2)
+        count *= 2;
+    return count;
+}
+
+size_t file_system::dedup_table_blocks() const
+{
+    return (dedup_bucket_count() * 4 + block_size_byte - 1) / block_size_byte
+           + (sb.block_count * sizeof(dedup_record) + block_size_byte - 1) / block_size_byte;
+}
+
+void file_system::free_data_block(size_t bno)
+{
+    if (has_feature(feature_dedup)) {
+        // a shared block is freed with its last reference, the others have no record
+        dedup_record rec = dedup_load(bno);
+        if (rec.refs > 1) {
+            rec.refs--;
+            dedup_store(bno, rec);
+            return;
         }
-        // put it to the buffer to write
-        inode_blocks.emplace_back(temp);
-        temp_blocks.pop_back();
-    }
-    // if the job is done it can exit
-    if(size == 0){
-        write_inode_blocks_buffer();
-        write_inode(inode_index);
-        write_superblock();
-        return;
+        if (rec.refs == 1)
+            dedup_remove(bno);
     }
-    // now it is part for the recursive indirect part
-    // if there is none allocate
-    size_t off = direct_count*block_size_byte;
-    size_t wb_size = write_buffer_size;
-    if(cur_block == direct_count){
-        if(in.si == 0){
-            in.si = get_free_block();
-            data_block zeros(block_size_byte);
-            zeros.bno = in.si;
-            write_block(zeros);
+    put_free_block(bno);
+}
+
+void file_system::unmap_blocks(uint16_t ino, size_t first, size_t last)
+{
+    inode & in = inodes[ino];
+    if (in.flags & inode_extents) {
+        // the extents are cut at the ends of the range
+        vector<file_extent> ext, res;
+        vector<size_t> freed;
+        load_extents(in, ext);
+        for (auto& e : ext) {
+            size_t end = e.lblk + e.len;
+            if (end <= first || e.lblk >= last) {
+                res.push_back(e);
+                continue;
+            }
+            for (size_t b = max<size_t>(e.lblk, first); b < min(end, last); ++b)
+                freed.push_back(e.pblk + (b - e.lblk));
+            if (e.lblk < first)
+                res.push_back(file_extent{e.lblk, e.pblk, (uint32_t) (first - e.lblk)});
+            if (end > last)
+                res.push_back(file_extent{(uint32_t) last, (uint32_t) (e.pblk + (last - e.lblk)), (uint32_t) (end - last)});
         }
-        size_t rel_block = ((pos - off) >> (10 + sb.block_size)) % block_size_byte;
-        write_helper(in.si,&pos,&size,buf,rel_block,1,off,&wb_size,&buf_pos);
-        cur_block++;
-    }
-    // if the job is done it can exit
-    if(size == 0){
-        write_inode_blocks_buffer();
-        write_inode(inode_index);
-        write_superblock();
+        // nothing is freed when the extents don't fit
+        store_extents(ino, res);
+        for (auto bno : freed)
+            put_free_block(bno);
         return;
     }
-    if(cur_block == direct_count+1){
-        if(in.di == 0){
-            in.di = get_free_block();
+    uint32_t* roots[] = {&in.si, &in.di, &in.ti};
+    size_t path[3];
+    for (size_t lblk = first; lblk < last; ++lblk) {
+        size_t levels = indirect_path(lblk, path);
+        if (levels > 0) {
+            unmap_indirect(*roots[levels - 1], path, levels);
         }
-        off += block_size_byte*block_size_byte/2;
-        size_t rel_block = ((pos - off) >> 2*(10 + sb.block_size)) % block_size_byte;
-        if(pos < off)
-            throw overflow_error("Overflow happened probably file is too big.");
-        write_helper(in.di,&pos,&size,buf,rel_block,2,off,&wb_size,&buf_pos);
-        cur_block++;
-    }
-    // if the job is done it can exit
-    if(size == 0){
-        write_inode_blocks_buffer();
-        write_inode(inode_index);
-        write_superblock();
-        return;
-    }
-    if(cur_block == 9){
-        if(in.ti == 0){
-            in.ti = get_free_block();
+        else if (in.ba[lblk] != 0) {
+            if (in.ba[lblk] != compressed_block)
+                free_data_block(in.ba[lblk]);
+            in.ba[lblk] = 0;
         }
-        off += block_size_byte*block_size_byte*block_size_byte/4;
-        size_t rel_block = ((pos - off) >> 3*(10 + sb.block_size)) % block_size_byte;
-        if(pos < off)
-            throw overflow_error("Overflow happened probably file is too big.");
-        write_helper(in.ti,&pos,&size,buf,rel_block,3,off,&wb_size,&buf_pos);
     }
-    write_superblock();
-    write_inode(inode_index);
+    write_inode(ino);
 }
 
-void file_system::write_helper(uint16_t address, uint32_t * pos, uint32_t * size,
-                               const char * buf, size_t rel_block, size_t level,size_t off,size_t* wb_size,size_t * buf_pos)
+void file_system::unmap_indirect(uint32_t& root, const size_t* path, size_t levels)
 {
-    if(*size == 0)
+    if (root == 0)
         return;
-    if(level == 0){
-        load_by_block_no(address);
-        data_block &temp = temp_blocks.back();
-        // assign the buf to the block
-        for (size_t i = *pos % block_size_byte; i < block_size_byte && *size > 0 ; ++i){
-            temp.arr[i] = buf[(*buf_pos)++];
-            ++(*pos);
-            --(*size);
-        }
-        // put it to the buffer to write
-        inode_blocks.emplace_back(temp);
-        temp_blocks.pop_back();
-        --(*wb_size);
-        // if it is time write the buffer
-        if(*wb_size == 0){
-            write_inode_blocks_buffer();
-            *wb_size = write_buffer_size;
-        }
+    uint32_t next = indirect_address(root, path[0]);
+    if (next == 0)
         return;
+    if (levels > 1)
+        unmap_indirect(next, path + 1, levels - 1);
+    else {
+        if (next != compressed_block)
+            free_data_block(next);
+        next = 0;
     }
-    else{
-        load_by_block_no(address);
-        data_block temp = temp_blocks.back();
-        temp_blocks.pop_back();
-        size_t block_count = block_size_byte >> 1;
-        uint16_t next_add = 0;
-        size_t new_rel = 0;
-        for (; rel_block < block_count; rel_block++)
-        {
-            next_add = temp.get_address(rel_block);
-            if(!next_add){
-                next_add = get_free_block();
-                temp.set_address(rel_block, next_add);
-                inode_blocks.emplace_back(temp);
-                ++(*wb_size);
-            }
-            if(level > 1){
-                new_rel = ((*pos - off) >> (level-1)*sb.block_size) % block_size_byte;
-            }
-            write_helper(next_add,pos,size,buf,new_rel,level-1,off,wb_size,buf_pos);
-            if(*size == 0)
-                return;
+    // the block under it is still in use
+    if (next != 0)
+        return;
+    load_by_block_no(root);
+    data_block& temp = temp_blocks.back();
+    temp.set_address(path[0], 0, addr_size);
+    bool empty = is_zero(temp.arr, block_size_byte);
+    write_block(temp);
+    temp_blocks.pop_back();
+    if (empty) {
+        put_free_block(root);
+        root = 0;
+    }
+}
+
+size_t file_system::indirect_alloc(uint32_t& root, const size_t* path, size_t levels, size_t addr)
+{
+    if (root == 0)
+        root = new_indirect_block();
+    size_t bno = root;
+    // the indirect blocks are allocated before the blocks they point to
+    for (size_t l = 0; l < levels; ++l) {
+        size_t next = indirect_address(bno, path[l]);
+        bool last = l + 1 == levels;
+        if (next == 0 || (last && addr != 0)) {
+            if (!last)
+                next = new_indirect_block();
+            else
+                next = addr != 0 ? addr : get_free_block();
+            load_by_block_no(bno);
+            data_block& temp = temp_blocks.back();
+            temp.set_address(path[l], next, addr_size);
+            write_block(temp);
+            temp_blocks.pop_back();
         }
+        bno = next;
     }
+    return bno;
 }
 
-void file_system::write_inode_blocks_buffer()
+size_t file_system::new_indirect_block()
 {
-    for (const auto& in : inode_blocks)
-        write_block(in);
-    inode_blocks.clear();
+    // a reused block may still hold the addresses of its old owner
+    data_block zeros(pool);
+    zeros.bno = get_free_block();
+    write_block(zeros);
+    return zeros.bno;
 }
 
-uint16_t file_system::get_free_inode() {
-    size_t i = 0;
-    for (i = 0; i < inodes.size(); ++i) {
-        if(inodes[i].type == empty_type){
-            sb.free_inode_count--;
-            init_inode(i);
-            inodes[i].type = file_type;
-            write_inode(i);
-            write_superblock();
-            return i;
-        }
-    }
-    throw underflow_error("No empty inode left.");
+void file_system::sync()
+{
+    // the blocks freed by the operation can be used by the next one
+    vector<size_t> held;
+    held.swap(held_blocks);
+    for (auto bno : held)
+        free_block(bno);
+    // changed metadata blocks go out in the same batch as the data blocks
+    flush_metadata();
+    cache.flush();
+    if (jrnl.is_open()) {
+        // with a journal they are logged as one transaction, the data blocks aren't ordered before it
+        vector<block_io> logged;
+        cache.get_logged(logged);
+        // nothing durable points to the blocks allocated by the operation before it is committed,
+        // they are written to their places first when the transaction doesn't fit in the log
+        if (!jrnl.fits(logged.size()))
+            write_fresh_blocks(logged);
+        jrnl.commit(logged, !held.empty());
+        cache.release_logged();
+        fresh_blocks.clear();
+    }
+    dev.sync();
+}
+
+void file_system::write_fresh_blocks(std::vector<block_io> &logged)
+{
+    // a block with a copy in the log stays in the log, the copy would be found again after a crash
+    vector<block_io> fresh, rest;
+    for (auto& req : logged)
+        (fresh_blocks.count(req.bno) != 0 && !dev.is_remapped(req.bno) ? fresh : rest).push_back(req);
+    if (fresh.empty())
+        return;
+    if (jrnl.has_unsynced_frees())
+        jrnl.sync();
+    dev.write_blocks(fresh);
+    dev.sync_all();
+    logged.swap(rest);
+}
+
+size_t file_system::default_journal_blocks() const
+{
+    return min(max_journal_blocks, max<size_t>(min_journal_blocks, sb.block_count / 256));
+}
+
+uint16_t file_system::get_free_inode(size_t near) {
+    size_t i = inode_map.find_free(near);
+    if (i == block_bitmap::npos)
+        throw underflow_error("No empty inode left.");
+    inode_map.set(i);
+    sb.free_inode_count--;
+    if (!groups.empty())
+        groups[i / sb.inodes_per_group].free_inodes--;
+    init_inode(i);
+    inodes[i].type = file_type;
+    write_inode(i);
+    write_superblock();
+    return i;
 }
 
 void file_system::put_free_inode(uint16_t index)
 {
     // get the tail block
     inodes[index].type = empty_type;
+    inode_map.clear(index);
+    if (!groups.empty())
+        groups[index / sb.inodes_per_group].free_inodes++;
     sb.free_inode_count++;
     write_superblock();
     write_inode(index);
 }
 
-uint16_t file_system::get_free_block()
+size_t file_system::get_free_block()
+{
+    return get_free_block(alloc_hint);
+}
+
+size_t file_system::get_free_block(size_t hint)
 {
+    // blocks reserved for the file being written are used first
+    if (reserved_next < reserved.size())
+        return reserved[reserved_next++];
+    if (has_feature(feature_bitmap)) {
+        size_t res = sb.fb_count == 0 ? block_bitmap::npos : bitmap.find_free(hint);
+        if (res == block_bitmap::npos)
+            throw length_error("No more free blocks left.");
+        take_block(res);
+        alloc_hint = res + 1;
+        return res;
+    }
     if (sb.fb_head == 0 || sb.fb_count == 0) {
         write_superblock();
         throw length_error("No more free blocks left.");
@@ -595,18 +2004,108 @@ uint16_t file_system::get_free_block()
     }
     temp_blocks.pop_back();
     write_superblock();
-    if(res > KB/sb.block_size)
+    if(res >= total_block_count())
         throw logic_error("Error returning a free block no.");
     return res;
 }
 
-void file_system::put_free_block(uint16_t bno)
+void file_system::take_block(size_t bno)
+{
+    // a journal needs v2 and v2 has the bitmap, only this path allocates with one
+    if (jrnl.is_open())
+        fresh_blocks.insert(bno);
+    bitmap.set(bno);
+    sb.fb_count--;
+    if (!groups.empty())
+        groups[bno / sb.blocks_per_group].free_blocks--;
+    write_superblock();
+}
+
+void file_system::release_block(size_t bno)
+{
+    // metadata blocks are never freed, group metadata comes before its data blocks
+    size_t meta_end = groups.empty() ? sb.root_dir_address : group_data_start(bno / sb.blocks_per_group);
+    if (bno < meta_end || !bitmap.test(bno))
+        throw invalid_argument("Given free block no is invalid.");
+    // the next owner may not keep a checksum for it
+    if (has_feature(feature_metadata_csum))
+        store_csum(bno, 0);
+    bitmap.clear(bno);
+    sb.fb_count++;
+    if (!groups.empty())
+        groups[bno / sb.blocks_per_group].free_blocks++;
+    write_superblock();
+}
+
+void file_system::reserve_blocks(size_t count)
+{
+    release_reserved();
+    if (count > sb.fb_count)
+        throw length_error("No more free blocks left.");
+    vector<size_t> res;
+    if (has_feature(feature_bitmap)) {
+        size_t start = bitmap.find_free_run(count, alloc_hint);
+        for (size_t i = 0; i < count; ++i) {
+            // when there is no run long enough the free pieces after the hint are used
+            size_t bno = start != block_bitmap::npos ? start + i : bitmap.find_free(alloc_hint);
+            take_block(bno);
+            res.push_back(bno);
+            alloc_hint = bno + 1;
+        }
+    }
+    else {
+        for (size_t i = 0; i < count; ++i)
+            res.push_back(get_free_block());
+    }
+    reserved = res;
+}
+
+void file_system::release_reserved()
+{
+    vector<size_t> rest(reserved.begin() + reserved_next, reserved.end());
+    reserved.clear();
+    reserved_next = 0;
+    for (auto bno : rest)
+        put_free_block(bno);
+}
+
+void file_system::write_reserved(uint16_t inode_index, const std::vector<char> &buf, size_t block_count)
+{
+    // blocks are handed out in the order write needs them so that
+    // every indirect block comes right before the blocks it points to
+    alloc_hint = block_hint(inode_index);
+    reserve_blocks(block_count);
+    try {
+        write(inode_index,0,buf.size(),buf.data());
+    }
+    catch (exception&) {
+        release_reserved();
+        throw;
+    }
+    release_reserved();
+}
+
+void file_system::put_free_block(size_t bno)
 {
-    if(bno > KB/sb.block_size)
+    if(bno >= total_block_count())
         throw invalid_argument("Given free block no is invalid.");
+    // the image uses the block until the operation is committed, its data can't be written over it
+    if(jrnl.is_open()){
+        held_blocks.push_back(bno);
+        return;
+    }
+    free_block(bno);
+}
+
+void file_system::free_block(size_t bno)
+{
+    if(has_feature(feature_bitmap)){
+        release_block(bno);
+        return;
+    }
     // if there is no free block make that the new free block list
     if(sb.fb_count == 0){
-        data_block zeros(block_size_byte);
+        data_block zeros(pool);
         zeros.bno = bno;
         sb.fb_tail = bno;
         sb.fb_head = bno;
@@ -646,49 +2145,74 @@ void file_system::init_directory(data_block & db,uint16_t index, uint16_t parent
     // modifying the block
     inodes[index].link_count = 1;
     inodes[index].type = dir_type;
-    inodes[index].size = 2*data_block::dir_entry_size;
-    vector<char> dir_ent = create_dir_entry(index,".");
-    vector<char> dir_ent2 = create_dir_entry(parent,"..");
-    for (size_t l = 0; l < data_block::dir_entry_size; ++l) {
-        db.arr[l] = dir_ent[l];
-        db.arr[l+data_block::dir_entry_size] = dir_ent2[l];
-    }
+    inodes[index].size = empty_dir_size();
+    // the root of an index is kept after the direct and indirect blocks, there is no room after the extents
+    if (has_feature(feature_dir_index))
+        inodes[index].flags &= ~inode_extents;
+    vector<char> dir_ent = create_dir_entry(index,".",dir_type);
+    vector<char> dir_ent2 = create_dir_entry(parent,"..",dir_type);
+    memcpy(db.arr,dir_ent.data(),dir_ent.size());
+    memcpy(db.arr+dir_ent.size(),dir_ent2.data(),dir_ent2.size());
 }
 
 // given path point to a folder
 void file_system::list_folders(const std::string &path) {
-    inode_blocks.clear();
     uint16_t path_inode = get_dir_inode(path);
     // checking if it is a folder or not
     if(inodes[path_inode].type != dir_type && inodes[path_inode].type != sym_dir)
         throw std::invalid_argument("Given path doesn't point to a listable object.");
-    load_inode_blocks(inodes[path_inode]);
     vector<string> names;
     vector<size_t > inode_nos;
-    for(auto &in: inode_blocks){
-        size_t dir_count = in.get_dir_entry_count();
-        for (size_t j = 2; j < dir_count; ++j) {
-            names.push_back(in.get_entry_name(j));
-            inode_nos.push_back(in.get_entry_inode_no(j));
+    // . and .. are the first two entries of the directory
+    size_t skip = 2;
+    dir_cursor dc;
+    dir_start(dc, inodes[path_inode]);
+    dir_entry ent;
+    while (dir_next(dc, ent)) {
+        if (skip > 0) {
+            skip--;
+            continue;
         }
+        names.emplace_back(ent.name, ent.name_len);
+        inode_nos.push_back(ent.inode);
     }
     size_t i = 0;
     inode * temp = nullptr;
-    const char * tempstr = nullptr;
     for(const auto& line : names){
         temp = &inodes[inode_nos[i]];
-        tempstr = string(line.data(),dir_name_size).append("\0").data();
-        printf("%7u %u %s %2u %.2d:%.2d:%.2d %s\n",temp->size,temp->year,
-                months[temp->month],temp->day,temp->hour,temp->min,temp->sec,tempstr);
+        printf("%7llu %u %s %2u %.2d:%.2d:%.2d %s\n",(unsigned long long) temp->size,temp->year,
+                months[temp->month],temp->day,temp->hour,temp->min,temp->sec,line.c_str());
         i++;
     }
     fflush(stdout);
-    inode_blocks.clear();
+}
+
+size_t file_system::print_block_list(const std::vector<size_t>& blocks) const {
+    size_t j = 0;
+    for(size_t k = 0; k < blocks.size(); ++k){
+        cout << blocks[k];
+        // large images list the runs of consecutive blocks
+        if(has_feature(feature_v2)){
+            size_t run_end = k;
+            while(run_end + 1 < blocks.size() && blocks[run_end + 1] == blocks[run_end] + 1)
+                run_end++;
+            if(run_end != k)
+                cout << "-" << blocks[run_end];
+            k = run_end;
+        }
+        cout << ", ";
+        j++;
+        if(j == 30){
+            cout << endl;
+            j = 0;
+        }
+    }
+    return j;
 }
 
 void file_system::dumpe2fs()  {
     // block count
-    size_t block_count =  KB/sb.block_size;
+    size_t block_count = total_block_count();
     // inode count sb.inode_count
     // fb count sb.free_blocks
     // sb.block size
@@ -698,7 +2222,7 @@ void file_system::dumpe2fs()  {
     get_all_occupied_names_blocks(nm,blk_map);
     // getting all free blocks
     vector<size_t> fblocks;
-    get_all_free_blocks(fblocks,sb.fb_tail);
+    load_free_blocks(fblocks);
     // getting all free inodes
     vector<size_t> finodes;
     size_t dir_count = 0;
@@ -711,19 +2235,52 @@ void file_system::dumpe2fs()  {
     cout << GREEN "Number Of Files: " RESET<< blk_map.size() - dir_count << endl;
     cout << GREEN "Number Of Directories: " RESET<< dir_count << endl;
     cout << GREEN "Block Size (KB): " RESET<< sb.block_size << endl;
-    size_t j = 0;
-    cout << endl <<GREEN "Free Blocks: " RESET << " (" <<fblocks.size() << "): ";
-    for(auto i: fblocks){
-        cout << i << ", ";
-        j++;
-        if(j == 30){
-            cout << endl;
-            j = 0;
+    if(has_feature(feature_compress))
+        cout << GREEN "Compression Cluster (Blocks): " RESET<< sb.cluster_blocks << endl;
+    if(has_feature(feature_dedup)){
+        // every block with a record is stored once for all its references
+        size_t stored = 0, refs = 0;
+        for (size_t bno = 0; bno < block_count; ++bno) {
+            dedup_record rec = dedup_load(bno);
+            stored += rec.refs != 0;
+            refs += rec.refs;
+        }
+        cout << GREEN "Dedup Table: " RESET << sb.dedup_pos << " (" << sb.dedup_blocks << " blocks)" << endl;
+        printf(GREEN "Deduplicated Blocks: " RESET "%zu for %zu references, ratio %.2f\n",
+               stored, refs, stored == 0 ? 1.0 : (double) refs / stored);
+    }
+    if(has_feature(feature_metadata_csum)){
+        cout << GREEN "Checksums: " RESET << (has_feature(feature_data_csum) ? "metadata and data" : "metadata");
+        if(groups.empty())
+            cout << ", table " << sb.csum_pos << " (" << sb.csum_blocks << " blocks)";
+        else
+            cout << ", " << csum_group_blocks() << " blocks after the inode table of every group";
+        cout << endl;
+    }
+    if(has_feature(feature_journal)){
+        cout << GREEN "Journal: " RESET << sb.journal_pos << " (" << sb.journal_blocks << " blocks), "
+             << jrnl.transaction_count() << " transactions in " << jrnl.used_blocks()
+             << " blocks since the last checkpoint" << endl;
+    }
+    if(has_feature(feature_groups)){
+        for (size_t g = 0; g < groups.size(); ++g) {
+            size_t end = min(total_block_count(), (g + 1) * sb.blocks_per_group);
+            size_t first_inode = g * sb.inodes_per_group;
+            size_t inode_end = min<size_t>(first_inode + sb.inodes_per_group, sb.inode_count);
+            cout << GREEN "Group " << g << ": " RESET << "blocks " << groups[g].first_block << "-" << end - 1
+                 << " bitmap " << groups[g].bitmap_pos << " inode table " << groups[g].inode_table;
+            if (first_inode < inode_end)
+                cout << " inodes " << first_inode << "-" << inode_end - 1;
+            cout << " free blocks " << groups[g].free_blocks << " free inodes " << groups[g].free_inodes << endl;
         }
     }
+    else if(has_feature(feature_bitmap))
+        cout << GREEN "Block Bitmap: " RESET << sb.bitmap_pos << " (" << sb.bitmap_blocks << " blocks)" << endl;
+    cout << endl <<GREEN "Free Blocks: " RESET << " (" <<fblocks.size() << "): ";
+    print_block_list(fblocks);
     cout << endl << endl;
     cout <<GREEN "Free Inodes:" RESET << " (" <<finodes.size() << "): ";
-    j = 0;
+    size_t j = 0;
     for(auto i: finodes){
         cout << i << ", ";
         j++;
@@ -738,20 +2295,10 @@ void file_system::dumpe2fs()  {
         cout << GREEN"-----------------------------" RESET << endl;
         cout << "Inode: " << in.first << endl;
         cout << "Occupied Blocks: ";
-        j = 0;
-        for(auto &ob: in.second){
-            cout << ob << ", ";
-            j++;
-            if(j == 30){
-                cout << endl;
-                j = 0;
-            }
-        }
+        j = print_block_list(in.second);
         cout << endl << "Occupied Names: ";
-        const char * tempstr = nullptr;
         for(auto &on: nm[in.first]){
-            tempstr = string(on.data(),dir_name_size).append("\0").data();
-            cout << tempstr << ", ";
+            cout << on << ", ";
             j++;
             if(j == 30){
                 cout << endl;
@@ -777,24 +2324,34 @@ void file_system::get_all_occupied_names_blocks(map<size_t, set<string>> &name_m
         }
     }
     for (auto& dir: all_dirs){
-        //clears the inode blocks
-        inode_blocks.clear();
-        load_inode_blocks(inodes[dir]);
-        //iterates through all blocks
-        for (auto& in : inode_blocks) {
-            size_t dir_count = in.get_dir_entry_count();
-            for (size_t j = 2; j < dir_count; ++j) {
-                name_map[in.get_entry_inode_no(j)].insert(in.get_entry_name(j));
+        //iterates through all entries, . and .. are the first two
+        size_t skip = 2;
+        dir_cursor dc;
+        dir_start(dc, inodes[dir]);
+        dir_entry ent;
+        while (dir_next(dc, ent)) {
+            if (skip > 0) {
+                skip--;
+                continue;
             }
+            name_map[ent.inode].insert(string(ent.name, ent.name_len));
         }
     }
     name_map[0].insert("/");
     for(auto& pair: blk_map){
         load_occupied_inode_blocks(pair.first,pair.second);
+        load_index_blocks(inodes[pair.first],pair.second);
     }
 
 }
 
+void file_system::load_free_blocks(std::vector<size_t> &res) {
+    if (has_feature(feature_bitmap))
+        bitmap.get_free_bits(res);
+    else
+        get_all_free_blocks(res, sb.fb_tail);
+}
+
 void file_system::get_all_free_blocks(std::vector<size_t> &res, size_t pos) {
     if(pos == 0)
         return;
@@ -821,22 +2378,43 @@ void file_system::get_all_free_blocks(std::vector<size_t> &res, size_t pos) {
         get_all_free_blocks(res,next);
 }
 
+void file_system::load_inode_map() {
+    // only kept in memory, the types in the inode table are the source
+    inode_map.reset(inodes.size(), (inodes.size() + 63) / 64 * 64);
+    for (size_t i = 0; i < inodes.size(); ++i) {
+        if (inodes[i].type != empty_type)
+            inode_map.set(i);
+    }
+}
+
 void file_system::get_all_free_inodes(std::vector<size_t> &res,size_t * dir_count) {
+    inode_map.get_free_bits(res);
     for (size_t i = 0; i < inodes.size(); ++i) {
-        if (inodes[i].type == empty_type)
-            res.push_back(i);
-        else if(inodes[i].type == dir_type || inodes[i].type == sym_dir)
+        if(inodes[i].type == dir_type || inodes[i].type == sym_dir)
             ++(*dir_count);
     }
 }
 
 void file_system::load_occupied_inode_blocks(size_t index, vector<size_t> &res) {
     inode in = inodes[index];
-    for (uint16_t i : in.ba) {
-        if(i != 0)
+    if (in.flags & inode_inline_data)
+        return;
+    if (in.flags & inode_extents) {
+        // only the extent block is read, if there is one
+        vector<file_extent> ext;
+        load_extents(in, ext);
+        for (auto& e : ext) {
+            for (size_t b = 0; b < e.len; ++b)
+                res.push_back(e.pblk + b);
+        }
+        if (in.ext_block != 0)
+            res.push_back(in.ext_block);
+        return;
+    }
+    // sparse files can have holes before their last block
+    for (size_t i : in.ba) {
+        if(i != 0 && i != compressed_block)
             res.push_back(i);
-        else
-            return;
     }
     load_occupied_inode_blocks_helper(index,res,in.si,1);
     load_occupied_inode_blocks_helper(index,res,in.di,2);
@@ -852,11 +2430,12 @@ void file_system::load_occupied_inode_blocks_helper(size_t index, vector<size_t>
     else{
         load_by_block_no(address);
         res.push_back(address);
-        data_block blk = temp_blocks.back();
+        data_block blk = std::move(temp_blocks.back());
         temp_blocks.pop_back();
         for (size_t i = 0; i < block_cap; ++i) {
-            if(blk.get_address(i) != 0)
-                load_occupied_inode_blocks_helper(index,res,blk.get_address(i),level-1);
+            size_t addr = blk.get_address(i, addr_size);
+            if(addr != 0 && addr != compressed_block)
+                load_occupied_inode_blocks_helper(index,res,addr,level-1);
         }
     }
 }
@@ -866,7 +2445,7 @@ void file_system::copy_file(const std::string& path, const char * fname) {
     file.exceptions(std::ios::failbit | std::ios::badbit);
     auto fsize = file.tellg();
 
-    if(fsize > max_file_size)
+    if((uint64_t) fsize > max_file_size())
         throw invalid_argument("Given file exceeds the size of the file system disk.");
 
     vector<char> buf(fsize);
@@ -875,12 +2454,19 @@ void file_system::copy_file(const std::string& path, const char * fname) {
     file.close();
     // write this buffer to the given path
     write_str_to_file(path, buf, false);
+    sync();
 }
 
-void file_system::write_str_to_file(const string &arg, std::vector<char> &buf, bool error_when_exist) {
+void file_system::write_str_to_file(const string &arg, std::vector<char> &buf, bool error_when_exist, size_t type) {
     string path,name;
     size_t parent;
     size_t block_needed = ceil(((double) buf.size())/((double) block_size_byte));
+    // blocks of zeros are left as holes
+    if(has_feature(feature_sparse)){
+        block_needed = 0;
+        for (size_t off = 0; off < buf.size(); off += block_size_byte)
+            block_needed += !is_zero(buf.data() + off, min<size_t>(block_size_byte, buf.size() - off));
+    }
     size_t si_block_needed = 0,di_block_needed = 0,ti_block_needed = 0;
     if(block_needed > direct_count)
         si_block_needed = ceil(((double)(block_needed - direct_count))/((double)block_cap));
@@ -888,14 +2474,25 @@ void file_system::write_str_to_file(const string &arg, std::vector<char> &buf, b
         di_block_needed = ceil(((double)(si_block_needed - 1))/((double)block_cap));
     if(di_block_needed > 1)
         ti_block_needed = ceil(((double)(di_block_needed - 1))/((double)block_cap));
-    if(block_needed + si_block_needed + di_block_needed + ti_block_needed > sb.fb_count)
+    size_t total_needed = block_needed + si_block_needed + di_block_needed + ti_block_needed;
+    // a file written at once is a single extent when there is a long enough free run
+    if(has_feature(feature_extents))
+        total_needed = block_needed;
+    // small files are kept in the i-node
+    if(has_feature(feature_inline_data) && buf.size() <= inline_capacity())
+        total_needed = 0;
+    // compressed and deduplicated files usually take fewer blocks, running out is found while writing
+    if(has_feature(feature_compress | feature_dedup) && total_needed > sb.fb_count)
+        total_needed = sb.fb_count;
+    if(total_needed > sb.fb_count)
         throw length_error("Given file is too big for the system.");
     // sets these values
     bool file_exists = new_file_args(arg, path, name, parent, error_when_exist);
 
     if(file_exists){
-        // get the existing file
-        size_t child = get_dir_inode(arg);
+        // get the existing file, its name was just looked up in the parent
+        size_t child = 0;
+        lookup_entry(parent, name, child);
         size_t to_write = child;
         if(inodes[child].type == sym_file){
             vector<char>path_to_link(inodes[child].size);
@@ -908,24 +2505,21 @@ void file_system::write_str_to_file(const string &arg, std::vector<char> &buf, b
         // update child size
         empty_inode_blocks(to_write);
         inodes[to_write].size = buf.size();
-        write(to_write,0,buf.size(),buf.data());
+        write_reserved(to_write,buf,total_needed);
         write_inode(parent);
         write_inode(to_write);
     }
     else{
         // now allocate inode and call write function
-        uint16_t newi = get_free_inode();
+        uint16_t newi = get_free_inode(parent);
         // set time for parent and child
         set_inode_time(parent);
         init_inode(newi);
         //init file attributes
-        init_file(newi,buf.size());
-        write(newi,0,buf.size(),buf.data());
-        vector<char> dir_ent = create_dir_entry(newi,name);
+        init_file(newi,buf.size(),type);
+        write_reserved(newi,buf,total_needed);
         //write the data blocks
-        uint32_t pos = get_inode_size(inodes[parent]);
-        write(parent,pos,data_block::dir_entry_size,dir_ent.data());
-        add_inode_size(parent,data_block::dir_entry_size);
+        add_dir_entry(parent,newi,name);
         write_inode(newi);
         write_inode(parent);
     }
@@ -941,8 +2535,8 @@ bool file_system::new_file_args(const std::string &arg, std::string &path, std::
     name = string(arg, last_slash + 1, arg.size() - last_slash);
     if(name.empty())
         throw invalid_argument("Please enter a valid file/directory name.");
-    if (name.size() > dir_name_size)
-        throw invalid_argument("File/Directory names should be at most 6 characters.");
+    if (name.size() > max_name_size())
+        throw invalid_argument("File/Directory names should be at most " + to_string(max_name_size()) + " characters.");
     if ((name.find('/') != string::npos) || (name.find(' ') != string::npos))
         throw invalid_argument("File/Directory name is invalid.");
     if (path.find(' ') != string::npos)
@@ -955,33 +2549,26 @@ bool file_system::new_file_args(const std::string &arg, std::string &path, std::
     inode i = inodes[parent];
     if (i.type != dir_type && i.type != sym_dir)
         throw invalid_argument("File or directory doesn't exist.");
-
-    //clears the inode blocks
-    inode_blocks.clear();
-    load_inode_blocks(i);
-    //check if file name is valid
-    for (auto &in : inode_blocks) {
-        size_t dir_count = in.get_dir_entry_count();
-        for (size_t j = 0; j < dir_count; ++j) {
-            if (in.get_entry_name(j) == name) {
-                if(error_when_exists)
-                    throw invalid_argument("File or directory name already exists.");
-                else
-                    return true;
-            }
-        }
-    }
-    inode_blocks.clear();
-
-    return false;
+    size_t found = 0;
+    if (!lookup_entry(parent, name, found))
+        return false;
+    if(error_when_exists)
+        throw invalid_argument("File or directory name already exists.");
+    return true;
 }
 
 
 
-void file_system::init_file(uint16_t index, size_t fsize) {
+void file_system::init_file(uint16_t index, size_t fsize, size_t type) {
     // modifying the block
     inodes[index].link_count = 1;
-    inodes[index].type = file_type;
+    inodes[index].type = type;
+    // compressed files are mapped by clusters of blocks instead of extents
+    if (has_feature(feature_compress) && type == file_type)
+        inodes[index].flags = (inodes[index].flags & ~inode_extents) | inode_compressed;
+    // and so are deduplicated ones, an extent can't cover blocks shared in another order
+    if (has_feature(feature_dedup) && type == file_type)
+        inodes[index].flags = (inodes[index].flags & ~inode_extents) | inode_dedup;
     inodes[index].size = fsize;
 }
 
@@ -1002,16 +2589,15 @@ void file_system::read_file(std::string path, const char *fname) {
 }
 
 void file_system::copy_system_file_to_buf(size_t iinode, char *buf, size_t size) {
-    inode_blocks.clear();
-    load_inode_blocks(inodes[iinode]);
-    for(auto& in: inode_blocks){
-        for (size_t i = 0; (i < block_size_byte) & (size > 0); ++i) {
-            *buf = in.arr[i];
-            ++buf;
-            --size;
-        }
+    readahead ra;
+    ra_start(ra, inodes[iinode]);
+    while (size > 0 && ra.next < ra.block_count) {
+        data_block in = ra_next(ra);
+        size_t len = min(size, in.size);
+        memcpy(buf, in.arr, len);
+        buf += len;
+        size -= len;
     }
-    inode_blocks.clear();
 }
 
 void file_system::set_inode_time(size_t i) {
@@ -1035,7 +2621,7 @@ void file_system::rmdir(const std::string &arg) {
     // the path should give an empty directory
     if(inodes[to_rm].type != dir_type && inodes[to_rm].type != sym_dir)
         throw invalid_argument("Given path doesn't show a directory.");
-    if(inodes[to_rm].size != 2*data_block::dir_entry_size)
+    if(inodes[to_rm].size != empty_dir_size())
         throw invalid_argument("Given directory is not empty.");
     // must inform parent to remove the directory entry
     remove_dir_entry(parent,name);
@@ -1043,6 +2629,7 @@ void file_system::rmdir(const std::string &arg) {
     clear_inode(to_rm);
     put_free_inode(to_rm);
     write_inode(to_rm);
+    sync();
 }
 // gives the inode to file and its parent
 void file_system::check_file_to_delete(const std::string& arg, std::string &path, std::string &name, size_t &to_rm,
@@ -1053,63 +2640,338 @@ void file_system::check_file_to_delete(const std::string& arg, std::string &path
 
     path = string(arg, 0, last_slash + 1);
     name = string(arg, last_slash + 1, arg.size() - last_slash);
-    if (name.size() > dir_name_size)
-        throw invalid_argument("File/Directory names should be at most 6 characters.");
+    if (name.size() > max_name_size())
+        throw invalid_argument("File/Directory names should be at most " + to_string(max_name_size()) + " characters.");
     if ((name.find('/') != string::npos) || (name.find(' ') != string::npos))
         throw invalid_argument("File/Directory name is invalid.");
     if (path.find(' ') != string::npos)
         throw  invalid_argument("Given path is invalid");
     if (name == "." || name == "..")
         throw  invalid_argument("Given file is invalid");
-    //first go to the location
-    to_rm = get_dir_inode(arg);
+    //first go to the location, the file is looked up in its parent
     parent =  get_dir_inode(path);
+    if (name.empty())
+        to_rm = get_dir_inode(arg);
+    else if (!lookup_entry(parent, name, to_rm))
+        throw invalid_argument("No such directory.");
     if(to_rm == 0)
         throw invalid_argument("Root directory cannot be removed.");
 }
 
 void file_system::remove_dir_entry(size_t iindex, const std::string &name) {
-    // get the last entry first to replace it with the one to be removed
-    size_t fsize = inodes[iindex].size;
-    vector<char> buf(fsize);
-    copy_system_file_to_buf(iindex,buf.data(),fsize);
-    size_t dir_count = fsize/(data_block::dir_entry_size);
-    size_t done = 0, to_rm_pos = 1;
-    for (size_t i = 1;(i < dir_count) && !done; ++i) {
-        if(data_block::get_entry_name_from_arr(i,buf.data()) == name){
-            done = 1;
-            to_rm_pos = i;
+    // . is the first entry and never removed
+    dir_cursor dc;
+    dir_start(dc, inodes[iindex]);
+    dir_entry ent;
+    bool found = false;
+    uint64_t prev = 0;
+    while (dir_next(dc, ent)) {
+        if (dc.pos != 0 && entry_is(ent, name)) {
+            found = true;
+            break;
         }
+        prev = dc.pos;
     }
-    if(!done)
+    if(!found)
         throw logic_error("File that is supposed to be here is not here.(System Corrupted Create Another System)");
-    buf.erase(buf.begin()+to_rm_pos*data_block::dir_entry_size,
-            buf.begin()+to_rm_pos*data_block::dir_entry_size+data_block::dir_entry_size);
-    // empties all allocated blocks
-    empty_inode_blocks(iindex);
-    write_superblock();
-    write(iindex,0,buf.size(),buf.data());
-    if(inodes[iindex].size < data_block::dir_entry_size)
-        throw logic_error("Inode attributes are corrupted.");
-    inodes[iindex].size  -= data_block::dir_entry_size;
+    uint64_t pos = dc.pos;
+    size_t rec_len = ent.rec_len;
+    dcache.insert(iindex,name,dentry_cache::no_entry);
+    if(inodes[iindex].flags & inode_dir_index)
+        dir_index_remove(iindex,name);
+    uint64_t size = get_inode_size(inodes[iindex]);
+    size_t in_block = pos % block_size_byte;
+    // only the blocks of the entry and of the last entry are written
+    if (pos + rec_len == size) {
+        remove_last_dir_entry(iindex);
+    }
+    else if (has_feature(feature_long_names) && in_block != 0) {
+        // the entry before it in the block takes its bytes
+        size_t len = pos + rec_len - prev;
+        char len_bytes[2] = {(char) (len >> 8), (char) len};
+        write(iindex,prev + 2,2,len_bytes);
+    }
+    else if (has_feature(feature_long_names) && (in_block + rec_len) % block_size_byte != 0) {
+        // the first entry of a block, the next one is moved to its place and takes its bytes
+        size_t next_len = 0;
+        vector<char> next = load_dir_entry(iindex, pos + rec_len, next_len);
+        set_record_length(next, rec_len + next_len);
+        write(iindex,pos,next.size(),next.data());
+    }
+    else {
+        // the last entry of the directory fills the hole, it fits any record of a block
+        uint64_t last_prev = 0;
+        size_t last_len = 0;
+        vector<char> moved = load_dir_entry(iindex, last_dir_entry(iindex, last_prev), last_len);
+        if (has_feature(feature_long_names))
+            set_record_length(moved, rec_len);
+        write(iindex,pos,moved.size(),moved.data());
+        remove_last_dir_entry(iindex);
+    }
     set_inode_time(iindex);
     write_inode(iindex);
+    write_superblock();
+}
+
+uint64_t file_system::last_dir_entry(size_t dir, uint64_t &prev) {
+    uint64_t size = get_inode_size(inodes[dir]);
+    uint64_t start = (size - 1) / block_size_byte * block_size_byte;
+    const data_block& blk = get_block(bmap(inodes[dir], start / block_size_byte));
+    dir_entry ent;
+    size_t last = 0;
+    prev = size;
+    for (size_t off = 0; next_dir_entry(blk.arr, size - start, off, ent); off += ent.rec_len) {
+        if (off != 0)
+            prev = start + last;
+        last = off;
+    }
+    return start + last;
+}
+
+void file_system::remove_last_dir_entry(size_t dir) {
+    uint64_t prev = 0;
+    uint64_t last = last_dir_entry(dir, prev);
+    uint64_t new_size = last;
+    // the entry before it in the block is cut to its own length and ends the directory
+    if (has_feature(feature_long_names) && prev != get_inode_size(inodes[dir])) {
+        size_t prev_len = 0;
+        vector<char> entry = load_dir_entry(dir, prev, prev_len);
+        new_size = prev + entry.size();
+        char len_bytes[2] = {(char) (entry.size() >> 8), (char) entry.size()};
+        write(dir,prev + 2,2,len_bytes);
+    }
+    // a block is freed only when it doesn't hold entries anymore
+    size_t blocks = (get_inode_size(inodes[dir]) + block_size_byte - 1) / block_size_byte;
+    size_t keep = (new_size + block_size_byte - 1) / block_size_byte;
+    if (keep < blocks)
+        unmap_blocks(dir, keep, blocks);
+    inodes[dir].size = new_size;
+    // the last entry of the block before was stretched to its end, it ends the directory now
+    if (has_feature(feature_long_names) && keep < blocks && new_size != 0) {
+        uint64_t last_prev = 0;
+        last = last_dir_entry(dir, last_prev);
+        size_t len = 0;
+        vector<char> entry = load_dir_entry(dir, last, len);
+        if (entry.size() < len) {
+            char len_bytes[2] = {(char) (entry.size() >> 8), (char) entry.size()};
+            write(dir,last + 2,2,len_bytes);
+            inodes[dir].size = last + entry.size();
+        }
+    }
+}
+
+std::vector<char> file_system::load_dir_entry(size_t dir, uint64_t pos, size_t &rec_len) {
+    uint64_t start = pos / block_size_byte * block_size_byte;
+    size_t valid = min<uint64_t>(block_size_byte, get_inode_size(inodes[dir]) - start);
+    const data_block& blk = get_block(bmap(inodes[dir], pos / block_size_byte));
+    dir_entry ent;
+    if (!next_dir_entry(blk.arr, valid, pos - start, ent))
+        throw logic_error("Data block directory entries are corrupted.");
+    rec_len = ent.rec_len;
+    return create_dir_entry(ent.inode, string(ent.name, ent.name_len), ent.type);
+}
+
+void file_system::set_record_length(std::vector<char> &entry, size_t rec_len) {
+    entry[2] = (char) (rec_len >> 8);
+    entry[3] = (char) rec_len;
+}
+
+void file_system::add_dir_entry(size_t dir, uint16_t index, const std::string &name) {
+    vector<char> dir_ent = create_dir_entry(index,name,inodes[index].type);
+    uint64_t fsize = get_inode_size(inodes[dir]);
+    size_t used = fsize % block_size_byte;
+    if (used != 0 && used + dir_ent.size() > block_size_byte) {
+        // finds the last entry of the last block to stretch it to the end of the block
+        const data_block& blk = get_block(bmap(inodes[dir], fsize / block_size_byte));
+        dir_entry ent;
+        size_t last = 0;
+        for (size_t off = 0; next_dir_entry(blk.arr, used, off, ent); off += ent.rec_len)
+            last = off;
+        next_dir_entry(blk.arr, used, last, ent);
+        size_t rec_len = ent.rec_len + block_size_byte - used;
+        char len_bytes[2] = {(char) (rec_len >> 8), (char) rec_len};
+        write(dir,fsize - used + last + 2,2,len_bytes);
+        add_inode_size(dir,block_size_byte - used);
+        fsize += block_size_byte - used;
+    }
+    write(dir,fsize,dir_ent.size(),dir_ent.data());
+    add_inode_size(dir,dir_ent.size());
+    dcache.insert(dir,name,index);
+    if(inodes[dir].flags & inode_dir_index)
+        dir_index_insert(dir,dir_ent);
+    // the index is made when the directory needs a second block
+    else if(has_feature(feature_dir_index) && get_inode_size(inodes[dir]) > block_size_byte)
+        build_dir_index(dir);
+}
+
+uint32_t file_system::name_hash(const char *name, size_t len) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) {
+        h ^= (uint8_t) name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+size_t file_system::index_bucket(const char *name, size_t len) const {
+    // fixed size names are hashed with their zero padding
+    char key[dir_name_size] = {0};
+    if (!has_feature(feature_long_names)) {
+        memcpy(key, name, min(len, dir_name_size));
+        name = key;
+        len = dir_name_size;
+    }
+    return name_hash(name, len) % (block_size_byte / 4);
+}
+
+bool file_system::dir_index_lookup(const inode &dir, const std::string &name, size_t &index) {
+    if (name.size() > max_name_size())
+        return false;
+    size_t leaf = get_block(dir.index_block).get_address(index_bucket(name.data(), name.size()), 4);
+    // the root and the leaf of the bucket are the only blocks read
+    while (leaf != 0) {
+        const data_block& blk = get_block(leaf);
+        size_t count = blk.get_address(0, 4);
+        dir_entry ent;
+        size_t off = index_leaf_header;
+        for (size_t k = 0; k < count && next_dir_entry(blk.arr, blk.cap, off, ent); ++k, off += ent.rec_len) {
+            if (entry_is(ent, name)) {
+                index = ent.inode;
+                return true;
+            }
+        }
+        leaf = blk.get_address(1, 4);
+    }
+    return false;
+}
+
+size_t file_system::index_leaf_end(const data_block &blk) const {
+    size_t count = blk.get_address(0, 4);
+    dir_entry ent;
+    size_t off = index_leaf_header;
+    for (size_t k = 0; k < count && next_dir_entry(blk.arr, blk.cap, off, ent); ++k)
+        off += ent.rec_len;
+    return off;
+}
+
+void file_system::dir_index_insert(size_t dir, const std::vector<char> &entry) {
+    dir_entry ent;
+    next_dir_entry(entry.data(), entry.size(), 0, ent);
+    size_t bucket = index_bucket(ent.name, ent.name_len);
+    size_t leaf = get_block(inodes[dir].index_block).get_address(bucket, 4);
+    size_t prev = 0;
+    // first leaf of the chain with enough room
+    while (leaf != 0 && index_leaf_end(get_block(leaf)) + entry.size() > block_size_byte) {
+        prev = leaf;
+        leaf = get_block(leaf).get_address(1, 4);
+    }
+    if (leaf == 0) {
+        data_block zeros(pool);
+        zeros.bno = leaf = get_free_block(inodes[dir].index_block + 1);
+        write_block(zeros);
+        // linked from the root or from the full leaf before it
+        load_by_block_no(prev == 0 ? inodes[dir].index_block : prev);
+        data_block& link = temp_blocks.back();
+        link.set_address(prev == 0 ? bucket : 1, leaf, 4);
+        write_block(link);
+        temp_blocks.pop_back();
+    }
+    load_by_block_no(leaf);
+    data_block& blk = temp_blocks.back();
+    memcpy(blk.arr + index_leaf_end(blk), entry.data(), entry.size());
+    blk.set_address(0, blk.get_address(0, 4) + 1, 4);
+    write_block(blk);
+    temp_blocks.pop_back();
+}
+
+void file_system::dir_index_remove(size_t dir, const std::string &name) {
+    size_t leaf = get_block(inodes[dir].index_block).get_address(index_bucket(name.data(), name.size()), 4);
+    while (leaf != 0) {
+        load_by_block_no(leaf);
+        data_block& blk = temp_blocks.back();
+        size_t count = blk.get_address(0, 4);
+        size_t end = index_leaf_end(blk);
+        dir_entry ent;
+        size_t off = index_leaf_header;
+        for (size_t k = 0; k < count && next_dir_entry(blk.arr, blk.cap, off, ent); ++k, off += ent.rec_len) {
+            if (!entry_is(ent, name))
+                continue;
+            // the entries after it are moved back
+            size_t rec_len = ent.rec_len;
+            memmove(blk.arr + off, blk.arr + off + rec_len, end - off - rec_len);
+            memset(blk.arr + end - rec_len, 0, rec_len);
+            blk.set_address(0, count - 1, 4);
+            write_block(blk);
+            temp_blocks.pop_back();
+            return;
+        }
+        leaf = blk.get_address(1, 4);
+        temp_blocks.pop_back();
+    }
+    throw logic_error("Directory index doesn't have the entry.");
+}
+
+void file_system::build_dir_index(size_t dir) {
+    size_t fsize = get_inode_size(inodes[dir]);
+    vector<char> buf(fsize);
+    copy_system_file_to_buf(dir,buf.data(),fsize);
+    data_block root(pool);
+    root.bno = get_free_block(block_hint(dir));
+    write_block(root);
+    inodes[dir].index_block = root.bno;
+    inodes[dir].flags |= inode_dir_index;
+    dir_entry ent;
+    for (size_t off = 0; next_dir_entry(buf.data(), fsize, off, ent); off += ent.rec_len)
+        dir_index_insert(dir,create_dir_entry(ent.inode,string(ent.name,ent.name_len),ent.type));
+    write_inode(dir);
+}
+
+void file_system::load_index_blocks(const inode &dir, std::vector<size_t> &res) {
+    if (!(dir.flags & inode_dir_index))
+        return;
+    res.push_back(dir.index_block);
+    size_t buckets = block_size_byte / 4;
+    for (size_t b = 0; b < buckets; ++b) {
+        size_t leaf = get_block(dir.index_block).get_address(b, 4);
+        for (; leaf != 0; leaf = get_block(leaf).get_address(1, 4))
+            res.push_back(leaf);
+    }
+}
+
+void file_system::free_dir_index(size_t dir) {
+    vector<size_t> blocks;
+    load_index_blocks(inodes[dir],blocks);
+    for (auto bno : blocks)
+        put_free_block(bno);
+    inodes[dir].flags &= ~inode_dir_index;
+    inodes[dir].index_block = 0;
 }
 
 void file_system::empty_inode_blocks(size_t iindex) {
     vector<size_t> blocks;
     load_occupied_inode_blocks(iindex,blocks);
-    vector<size_t> block_set(blocks);
-    for(auto bno: block_set)
-        put_free_block(bno);
+    // shared blocks are in the list once for every reference of the i-node
+    for(auto bno: blocks)
+        free_data_block(bno);
     for(auto& ba: inodes[iindex].ba)
         ba = 0;
     inodes[iindex].si = 0;
     inodes[iindex].di = 0;
     inodes[iindex].ti = 0;
+    inodes[iindex].ext_count = 0;
+    inodes[iindex].ext_block = 0;
+    // the next contents may fit in the i-node again, the index stays with the directory
+    uint16_t kept = inodes[iindex].flags & (inode_dir_index | inode_compressed | inode_dedup);
+    inodes[iindex].flags = new_inode_flags() | kept;
+    if ((kept & (inode_compressed | inode_dedup)) || (inodes[iindex].type == dir_type && has_feature(feature_dir_index)))
+        inodes[iindex].flags &= ~inode_extents;
 }
 
 void file_system::clear_inode(size_t index) {
+    // the names in a removed directory are gone with it
+    dcache.erase_dir(index);
+    free_dir_index(index);
     empty_inode_blocks(index);
     inodes[index].size = 0;
     inodes[index].type = empty_type;
@@ -1125,16 +2987,15 @@ void file_system::hard_link(const std::string& src, const std::string& dest) {
     new_file_args(dest, link_file_path, link_file_name, link_parent);
     size_t src_index = get_dir_inode(src);
     // adding a directory entry to link path contains | inode - dirname |
-    auto dir_entry = create_dir_entry(src_index,link_file_name);
-    write(link_parent,inodes[link_parent].size,data_block::dir_entry_size,dir_entry.data());
+    add_dir_entry(link_parent,src_index,link_file_name);
     // updating the parent inode
-    add_inode_size(link_parent,data_block::dir_entry_size);
     set_inode_time(link_parent);
     // updating src inode
     inodes[src_index].link_count++;
     // writing the changes to the disk
     write_inode(src_index);
     write_inode(link_parent);
+    sync();
 }
 
 void file_system::soft_link(const std::string &src, const std::string &dest) {
@@ -1144,10 +3005,8 @@ void file_system::soft_link(const std::string &src, const std::string &dest) {
     // get inode of src just to check if it exists or not
     get_dir_inode(src);
     vector<char> buf(src.begin(),src.end());
-    write_str_to_file(dest,buf,true);
-    size_t link_index = get_dir_inode(dest);
-    inodes[link_index].type = sym_file;
-    write_inode(link_index);
+    write_str_to_file(dest,buf,true,sym_file);
+    sync();
 }
 
 void file_system::del(const string & arg) {
@@ -1174,12 +3033,13 @@ void file_system::del(const string & arg) {
         i.link_count--;
     }
     write_inode(to_rm);
+    sync();
 }
 
 void file_system::fsck() {
     // getting all free blocks
     vector<size_t> fblocks;
-    get_all_free_blocks(fblocks,sb.fb_tail);
+    load_free_blocks(fblocks);
     map<size_t,set<string>> nm;
     // inode and the blocks it occupies
     map<size_t ,vector<size_t>> blk_map;
@@ -1218,18 +3078,30 @@ void file_system::fsck() {
             << "Data Blocks "<<"("<< free_map.size() << ")"<< endl;
     for(auto& blk: free_map){
         newline++;
-        printf("Data Block %4lu:" GREEN "|%lu%lu|    " RESET,blk.first,blk.second,full_map[blk.first]);
+        printf("Data Block %4zu:" GREEN "|%zu%zu|    " RESET,blk.first,blk.second,full_map[blk.first]);
         if(newline == 5){
             cout << endl;
             newline = 0;
         }
     }
     cout << endl;
+    if(has_feature(feature_dedup)){
+        // a shared block is occupied once for every reference
+        vector<size_t> wrong;
+        for(auto& blk: full_map){
+            size_t refs = dedup_load(blk.first).refs;
+            if(refs != 0 && refs != blk.second)
+                wrong.push_back(blk.first);
+        }
+        cout << "Shared Blocks With Wrong Reference Counts (" << wrong.size() << "): ";
+        print_block_list(wrong);
+        cout << endl;
+    }
     newline = 0;
     cout << "Inodes " << "(" << free_inodes.size() << ")" << endl;
     for(auto& i: free_inodes){
         newline++;
-        printf("Inode %4lu:" GREEN "|%lu%lu|    " RESET,i.first,i.second,full_inodes[i.first]);
+        printf("Inode %4zu:" GREEN "|%zu%zu|    " RESET,i.first,i.second,full_inodes[i.first]);
         if(newline == 7){
             cout << endl;
             newline = 0;
@@ -1238,6 +3110,115 @@ void file_system::fsck() {
     cout << endl;
 }
 
+void file_system::punch(const std::string &path, uint64_t offset, uint64_t length) {
+    if(!has_feature(feature_sparse))
+        throw invalid_argument("Holes can only be punched in images with the sparse feature.");
+    size_t ino = get_dir_inode(path);
+    if(inodes[ino].type != file_type)
+        throw invalid_argument("Given path doesn't show a file.");
+    uint64_t size = get_inode_size(inodes[ino]);
+    uint64_t end = min(size, offset + length);
+    if(length == 0 || offset >= end)
+        return;
+    vector<char> zeros(min<uint64_t>(end - offset, block_size_byte), 0);
+    if(inodes[ino].flags & inode_inline_data){
+        write(ino,offset,end - offset,zeros.data());
+        sync();
+        return;
+    }
+    if(inodes[ino].flags & inode_compressed){
+        // clusters are rewritten with zeros, the ones left with only zeros become holes
+        uint64_t cluster_bytes = sb.cluster_blocks * block_size_byte;
+        zeros.assign(min(end - offset, cluster_bytes), 0);
+        for (uint64_t pos = offset, len = 0; pos < end; pos += len) {
+            len = min(end - pos, cluster_bytes - pos % cluster_bytes);
+            write(ino,pos,len,zeros.data());
+        }
+        set_inode_time(ino);
+        write_inode(ino);
+        sync();
+        return;
+    }
+    // whole blocks are freed, the last block of the file is freed when the range covers its data
+    size_t first = (offset + block_size_byte - 1) / block_size_byte;
+    size_t last = (end == size) ? (size + block_size_byte - 1) / block_size_byte : end / block_size_byte;
+    if(first < last){
+        unmap_blocks(ino,first,last);
+    }
+    // the parts of the blocks at the ends are cleared, writes over holes are skipped
+    uint64_t head_end = min<uint64_t>(end, (uint64_t) first * block_size_byte);
+    if(offset < head_end)
+        write(ino,offset,head_end - offset,zeros.data());
+    uint64_t tail = max<uint64_t>(head_end, (uint64_t) last * block_size_byte);
+    if(tail < end)
+        write(ino,tail,end - tail,zeros.data());
+    set_inode_time(ino);
+    write_inode(ino);
+    write_superblock();
+    sync();
+}
+
+void file_system::scrub() {
+    if(!has_feature(feature_metadata_csum))
+        throw invalid_argument("Image has no checksums to verify.");
+    auto start = chrono::steady_clock::now();
+    vector<size_t> bnos;
+    vector<uint32_t> sums;
+    for (size_t bno = 0; bno < total_block_count(); ++bno) {
+        uint32_t sum = load_csum(bno);
+        if (sum != 0) {
+            bnos.push_back(bno);
+            sums.push_back(sum);
+        }
+    }
+    size_t thread_count = max(1u, thread::hardware_concurrency());
+    size_t batch = max<size_t>(1, scrub_batch_bytes / block_size_byte);
+    vector<char> bufs[2];
+    bufs[0].resize(batch * block_size_byte);
+    bufs[1].resize(batch * block_size_byte);
+    vector<size_t> bad;
+    mutex bad_lock;
+    // the blocks of a batch are split between the threads
+    auto check = [&](const char* buf, size_t first, size_t count) {
+        vector<thread> workers;
+        size_t per_thread = (count + thread_count - 1) / thread_count;
+        for (size_t from = 0; from < count; from += per_thread) {
+            workers.emplace_back([&, from]() {
+                for (size_t i = from; i < min(count, from + per_thread); ++i) {
+                    if (crc32c::of(buf + i * block_size_byte, block_size_byte) != sums[first + i]) {
+                        lock_guard<mutex> guard(bad_lock);
+                        bad.push_back(bnos[first + i]);
+                    }
+                }
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+    };
+    // a batch is checked while the next one is read into the other buffer
+    thread checker;
+    for (size_t first = 0, k = 0; first < bnos.size(); first += batch, k ^= 1) {
+        size_t count = min(batch, bnos.size() - first);
+        vector<block_io> reqs;
+        for (size_t i = 0; i < count; ++i)
+            reqs.push_back(block_io{bnos[first + i], bufs[k].data() + i * block_size_byte});
+        dev.read_blocks(reqs);
+        if (checker.joinable())
+            checker.join();
+        checker = thread(check, bufs[k].data(), first, count);
+    }
+    if (checker.joinable())
+        checker.join();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    double mb = (double) bnos.size() * block_size_byte / (1 << 20);
+    sort(bad.begin(), bad.end());
+    printf(GREEN "Verified Blocks: " RESET "%zu (%.1f MB) in %.3f s, %.1f MB/s with %zu threads\n",
+           bnos.size(), mb, seconds, seconds > 0 ? mb / seconds : 0.0, thread_count);
+    cout << GREEN "Checksum Errors: " RESET << "(" << bad.size() << "): ";
+    print_block_list(bad);
+    cout << endl;
+}
+
 void file_system::rec_inode_lookup(std::map<size_t,size_t> &full_inodes) {
     // list all the directories
     vector<bool> visited(inodes.size(),false);
@@ -1247,161 +3228,24 @@ void file_system::rec_inode_lookup(std::map<size_t,size_t> &full_inodes) {
 
 void file_system::rec_inode_lookup(std::map<size_t, size_t> &full_inodes, size_t pos, std::vector<bool>& visited) {
     visited[pos] = true;
-    inode_blocks.clear();
-    load_inode_blocks(inodes[pos]);
     vector<size_t> dir_inodes;
-    size_t dir_count=0,iindex=0;
-    for(auto& blk: inode_blocks){
-        dir_count = blk.get_dir_entry_count();
-        for (size_t i = 2; i < dir_count; ++i) {
-            iindex = blk.get_entry_inode_no(i);
-            if(inodes[iindex].type == dir_type && !visited[iindex])
-                dir_inodes.push_back(iindex);
-            full_inodes[iindex]++;
+    // . and .. are the first two entries
+    size_t skip = 2;
+    dir_cursor dc;
+    dir_start(dc, inodes[pos]);
+    dir_entry ent;
+    while (dir_next(dc, ent)) {
+        if (skip > 0) {
+            skip--;
+            continue;
         }
+        // the type in the entry saves looking at the i-node
+        size_t type = ent.type != 0 ? ent.type : inodes[ent.inode].type;
+        if(type == dir_type && !visited[ent.inode])
+            dir_inodes.push_back(ent.inode);
+        full_inodes[ent.inode]++;
     }
-    inode_blocks.clear();
     for(auto dir_inode: dir_inodes)
         rec_inode_lookup(full_inodes, dir_inode,visited);
 
 }
-
-data_block::~data_block() {
-    delete[] arr;
-}
-
-data_block::data_block(const data_block& d) {
-    size = d.size;
-    cap = d.cap;
-    bno = d.bno;
-    arr = new char[d.cap];
-    for (size_t i = 0; i < d.cap; ++i) {
-        arr[i] = d.arr[i];
-    }
-}
-
-data_block::data_block(const char* iarr, size_t size, size_t cap, size_t bno) {
-    this->size = size;
-    this->cap = cap;
-    this->bno = bno;
-    arr = new char[cap];
-    for (size_t i = 0; i < cap; ++i) {
-        arr[i] = iarr[i];
-    }
-}
-
-data_block& data_block::operator=(const data_block& d) {
-    if(this == &d)
-        return *this;
-    this->size = d.size;
-    this->cap = d.cap;
-    delete[] arr;
-    arr = new char[cap];
-    for (size_t i = 0; i < cap; ++i) {
-        arr[i] = d.arr[i];
-    }
-    this->bno = d.bno;
-    return *this;
-}
-
-size_t data_block::get_entry_inode_no(size_t index) const{
-    if (index * 8 + 8 > size)
-        throw range_error("Directory entry index is invalid.");
-    size_t res = 0;
-    res = (uint8_t)arr[index * 8 + 1];
-    res += ((uint8_t)arr[index * 8] << 8);
-
-    return res;
-}
-
-size_t data_block::get_address(size_t index) const{
-    if (index * 2 + 2 > cap)
-        throw range_error("Address entry index is invalid.");
-    size_t res = 0;
-    res = (size_t)((unsigned char)arr[index * 2 + 1]);
-    res += (((size_t)((unsigned char) arr[index * 2]))<< 8);
-    return res;
-}
-
-size_t data_block::get_bno() {
-    return bno;
-}
-
-size_t data_block::get_fb_size() const {
-    size_t i = 0;
-    for (i = 0; i < cap/2-1; i++)
-    {
-        if (!arr[2 * i] && !arr[2 * i + 1]) {
-            break;
-        }
-    }
-    return i;
-}
-
-std::string data_block::get_entry_name(size_t index) const {
-    if (index * 8 + 8 > size)
-        throw invalid_argument("Directory entry index is invalid.");
-
-    return get_entry_name_from_arr(index, arr);
-}
-
-size_t data_block::get_dir_entry_count() const{
-    if (size % 8 != 0)
-        throw logic_error("Data block directory entries are corrupted.");
-    return size / 8;
-}
-
-void data_block::push_address(size_t address) {
-    size = size + 2;
-    if (size > cap) {
-        throw std::invalid_argument("Capacity of block node is full.");
-    }
-    arr[size - 1] = (uint8_t) (address % one_byte);
-    arr[size - 2] = (uint8_t)(address >> 8);
-}
-
-size_t data_block::pop_address() {
-    if (size < 2) {
-        throw std::invalid_argument("Block node is empty.");
-    }
-    size = size - 2;
-    size_t res = 0;
-    res = (size_t) (unsigned char)arr[size+1];
-    res += (((size_t) (unsigned char)arr[size]) << 8);
-
-    arr[size] = 0;
-    arr[size+1] = 0;
-    return res;
-}
-
-void data_block::set_address(size_t index, uint16_t address)
-{
-    if (index+1 > cap) {
-        throw std::range_error("Given index is out of range.");
-    }
-    arr[2*index + 1] = uint8_t(address % one_byte);
-    arr[2*index] = uint8_t(address >> 8);
-}
-
-void data_block::clear_block()
-{
-    for (size_t i = 0; i < cap; i++){
-        arr[i] = 0;
-    }
-    size = 0;
-}
-
-data_block::data_block(size_t blk_size) {
-    arr = new char[blk_size];
-    for (size_t i = 0; i < blk_size;i++) {
-        arr[i] = 0;
-    }
-    cap  = blk_size;
-    size = 0;
-    bno = 0;
-}
-
-string data_block::get_entry_name_from_arr(size_t index, char *arr) {
-    string res(arr+8 * index + 2,dir_entry_size);
-    return string(res.data(),strlen(res.data()));
-}
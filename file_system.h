@@ -10,6 +10,12 @@
 #include <stdexcept>
 #include <map>
 #include <set>
+#include "block_bitmap.h"
+#include "block_device.h"
+#include "buffer_cache.h"
+#include "data_block.h"
+#include "journal.h"
+#include "dentry_cache.h"
 
 /* WARNING: THIS WILL WORK ON MACHINES WHERE ONE CHAR IS A BYTE */
 
@@ -17,44 +23,34 @@
 #define GREEN   "\033[32m"
 #define KB 1024
 
-class data_block {
-public:
-    data_block(const char* iarr, size_t size, size_t cap, size_t bno);
-    ~data_block();
-    explicit data_block(size_t blk_size);
-    data_block(const data_block& d);
-    data_block& operator=(const data_block& d);
-
-    void push_address(size_t address);
-    size_t pop_address();
-
-    void set_address(size_t index, uint16_t address);
-    void clear_block();
-
-    size_t get_entry_inode_no(size_t index) const;
-    std::string get_entry_name(size_t index) const;
-    static std::string get_entry_name_from_arr(size_t index, char *arr);
-
-    size_t get_dir_entry_count() const;
-    size_t get_address(size_t index) const;
-
-    size_t get_bno();
-
-    //special for free block nodes.
-    size_t get_fb_size() const;
+// a run of len blocks of a file starting at logical block lblk and physical block pblk
+struct file_extent {
+    uint32_t lblk;
+    uint32_t pblk;
+    uint32_t len;
+};
 
-private:
-    const static size_t one_byte = 256;
-    const static size_t dir_entry_size = 8;
-    size_t bno = 0;
-    size_t cap = 0;
-    size_t size = 0;
-    char* arr = nullptr;
-
-    friend class file_system;
+// reference count and content hash of a data block with feature_dedup, the next
+// block with a hash in the same bucket of the hash index or 0
+struct dedup_record {
+    uint32_t refs;
+    uint32_t next;
+    uint64_t hash;
 };
 
+// directory entry read from a block, name points into the block and isn't zero terminated
+struct dir_entry {
+    size_t inode;
+    // type of the i-node, 0 in the fixed size entries that don't keep it
+    uint8_t type;
+    const char* name;
+    size_t name_len;
+    // bytes from this entry to the next one
+    size_t rec_len;
+};
 
+/* In memory i-node and superblock are wide enough for every format,
+ * they are converted from and to the on disk layout of the image. */
 struct inode {
     //date
     uint16_t year;
@@ -65,37 +61,130 @@ struct inode {
     uint8_t min;
     uint8_t sec;
 
-    uint32_t size;
+    uint64_t size;
     // if it is a dir/file or soft link
     uint8_t type;
     // link count
     uint16_t link_count;
     //direct block addresses
-    uint16_t ba[5];
+    uint32_t ba[5];
     // single double and triple indirect addresses
-    uint16_t si;
-    uint16_t di;
-    uint16_t ti;
+    uint32_t si;
+    uint32_t di;
+    uint32_t ti;
+    // i-node flags of format v2
+    uint16_t flags;
+    // with inode_extents the blocks are mapped by extents sorted by lblk instead,
+    // the ones after the inline extents are kept in ext_block
+    uint32_t ext_count;
+    file_extent ext[3];
+    uint32_t ext_block;
+    // contents of a small file with inode_inline_data, no blocks are allocated for it
+    char inline_data[108];
+    // root block of the hashed index of a directory with inode_dir_index
+    uint32_t index_block;
 };
 
 struct superblock {
     superblock() = default;
-    uint16_t block_size;
-    uint16_t root_dir_address;
-    uint16_t inode_pos;
-    uint16_t inode_count;
-    uint16_t free_inode_count;
-    uint16_t fb_count;
-    uint16_t fb_head;
-    uint16_t fb_tail;
+    uint32_t block_size;
+    uint32_t root_dir_address;
+    uint32_t inode_pos;
+    uint32_t inode_count;
+    uint32_t free_inode_count;
+    uint64_t fb_count;
+    uint32_t fb_head;
+    uint32_t fb_tail;
+    // the fields below are only stored when magic matches, older images end before them
+    uint32_t magic;
+    uint32_t features;
+    uint32_t bitmap_pos;
+    uint32_t bitmap_blocks;
+    uint32_t group_count;
+    uint32_t blocks_per_group;
+    uint32_t inodes_per_group;
+    // blocks compressed together with feature_compress
+    uint32_t cluster_blocks;
+    // fixed by the block size before format v2
+    uint64_t block_count;
+    // hash index and reference counts with feature_dedup
+    uint32_t dedup_pos;
+    uint32_t dedup_blocks;
+    // checksum table with feature_metadata_csum, each group has its own slice with feature_groups
+    uint32_t csum_pos;
+    uint32_t csum_blocks;
+    // log of the metadata blocks with feature_journal
+    uint32_t journal_pos;
+    uint32_t journal_blocks;
+};
+
+// positions and free counts of one allocation group, the table follows the superblock
+struct group_desc {
+    uint32_t first_block;
+    uint32_t bitmap_pos;
+    uint32_t inode_table;
+    uint16_t free_blocks;
+    uint16_t free_inodes;
+};
+
+// on disk layout chosen when the image is created
+struct format_options {
+    uint32_t features = 0;
+    // requested number of allocation groups with feature_groups
+    size_t group_count = 0;
+    // image size in bytes with feature_v2, 0 keeps the 1 MiB of format v1
+    uint64_t image_size = 0;
+    // blocks in a compression cluster with feature_compress
+    size_t cluster_blocks = 4;
+    // blocks of the log with feature_journal, 0 sizes it by the image
+    size_t journal_blocks = 0;
+};
+
+// per session settings chosen by the caller
+struct fs_options {
+    block_device::io_mode mode = block_device::pread_mode;
+    // capacity of the buffer cache in blocks
+    size_t cache_blocks = 256;
+    // the checksums of the metadata read when the image is opened are verified
+    bool check_metadata = true;
+    // transactions of the journal made durable by one sync
+    size_t commit_interval = 16;
 };
 
 class file_system {
 public:
+    // optional on disk format features
+    static const uint32_t feature_bitmap = 1;
+    // implies feature_bitmap, every group has its own bitmap and inode table slice
+    static const uint32_t feature_groups = 2;
+    // format v2, 32 bit block addresses, 64 bit file sizes and any image size, implies feature_bitmap
+    static const uint32_t feature_v2 = 4;
+    // implies feature_v2, new i-nodes map their blocks with extents
+    static const uint32_t feature_extents = 8;
+    // implies feature_v2, i-nodes are larger and small files are kept in them
+    static const uint32_t feature_inline_data = 16;
+    // implies feature_v2, directories larger than a block get a hashed index of their entries
+    static const uint32_t feature_dir_index = 32;
+    // implies feature_v2, directory entries have a length and hold names up to 255 bytes
+    static const uint32_t feature_long_names = 64;
+    // blocks of zeros aren't allocated, unmapped blocks read as zeros and holes can be punched
+    static const uint32_t feature_sparse = 128;
+    // implies feature_v2, files are compressed in clusters of blocks
+    static const uint32_t feature_compress = 256;
+    // implies feature_v2, blocks of files with the same contents are stored once
+    static const uint32_t feature_dedup = 512;
+    // implies feature_v2, the superblock and the metadata blocks have CRC32C checksums
+    static const uint32_t feature_metadata_csum = 1024;
+    // implies feature_metadata_csum, data blocks of files have checksums too
+    static const uint32_t feature_data_csum = 2048;
+    // implies feature_v2, the metadata blocks of an operation are logged as one transaction before they are written
+    static const uint32_t feature_journal = 4096;
+
     // for creating object
-    file_system(size_t block_size, size_t inode_count);
+    file_system(size_t block_size, size_t inode_count, const format_options& format = format_options());
     // for getting the instance from the file
-    explicit file_system(const char* filename);
+    explicit file_system(const char* filename, const fs_options& opts = fs_options());
+    ~file_system();
     // for creating a file of the object
     void create_file(const char* filename);
 
@@ -119,21 +208,111 @@ public:
     void del(const std::string& arg);
     // file system check
     void fsck();
+    // frees the blocks of the byte range of a file, the range reads as zeros afterwards
+    void punch(const std::string& path, uint64_t offset, uint64_t length);
+    // verifies the checksum of every block that has one, the blocks are read in batches and checked in parallel
+    void scrub();
 
 private:
+    // sequential reader state over the blocks of an inode
+    struct readahead {
+        inode in;
+        // decompressed cluster of a compressed i-node
+        std::vector<char> cluster;
+        size_t cluster_no = 0;
+        size_t size = 0;
+        size_t block_count = 0;
+        // next logical block of the consumer
+        size_t next = 0;
+        // logical blocks before this are already prefetched
+        size_t ra_end = 0;
+        size_t window = 0;
+    };
+
+    // entries of a directory read one block at a time
+    struct dir_cursor {
+        readahead ra;
+        // current block and the offset of the next entry in it
+        data_block blk;
+        size_t off = 0;
+        // offset in the directory of the entry returned last
+        uint64_t pos = 0;
+    };
+
+    // prints 30 block numbers a line, returns the count on the last line
+    size_t print_block_list(const std::vector<size_t>& blocks) const;
     uint16_t get_dir_inode(std::string path);
-    uint16_t get_dir_inode_helper(std::string& path,const inode& i);
-    void load_inode_blocks(inode i);
+    // i-node of the name in the directory, through the dentry cache
+    bool lookup_entry(size_t dir, const std::string& name, size_t& index);
+    // reads the directory until the name is found
+    bool search_dir(const inode& i, const std::string& name, size_t& index);
     void load_by_block_no(size_t bno, size_t size);
+    // cached block, its checksum is verified the first time it is read
+    const data_block& get_block(size_t bno);
+    void check_csum(size_t bno, const char* arr, uint32_t sum);
+    // 0 when the block has no checksum
+    uint32_t load_csum(size_t bno);
+    void store_csum(size_t bno, uint32_t sum);
+    void csum_record_pos(size_t bno, size_t& blk, size_t& off) const;
+    size_t csum_group_blocks() const;
+    // checks the superblock, group descriptor, i-node table and bitmap blocks
+    void verify_metadata();
     // changes inode blocks and writes them to the given inode before flushing
-    void write(uint16_t inode_index, uint32_t pos, uint32_t size,const char* buf);
-    void write_str_to_file(const std::string &arg, std::vector<char> &buf, bool error_when_exist);
-    void write_block(const data_block& b) const;
+    void write(uint16_t inode_index, uint64_t pos, uint64_t size,const char* buf);
+    // type is the type of the i-node when a new one is made
+    void write_str_to_file(const std::string &arg, std::vector<char> &buf, bool error_when_exist,
+                           size_t type = file_type);
+    // data is true for the blocks of files, they only have checksums with feature_data_csum
+    void write_block(const data_block& b, bool data = false);
+    // writes a whole block from arr without copying it to a block first
+    void write_block(size_t bno, const char* arr, bool data);
+    // only mark the superblock or the inode table block dirty
     void write_superblock();
     void write_inode(uint16_t ino);
-    void write_helper(uint16_t address, uint32_t * pos, uint32_t * size,const char * buf,
-                      size_t rel_block,size_t level,size_t off,size_t* wb_size,size_t * buf_pos);
-    void write_inode_blocks_buffer();
+    // puts the dirty superblock and inode table blocks to the cache
+    void flush_metadata();
+    // physical block of the logical block lblk, the missing blocks on the way are allocated
+    size_t bmap_alloc(uint16_t ino, size_t lblk);
+    // addr is put at the end of the path instead of a new block when it isn't 0
+    size_t indirect_alloc(uint32_t& root, const size_t* path, size_t levels, size_t addr = 0);
+    // indexes of lblk in every level of the indirect blocks, returns the level count
+    size_t indirect_path(size_t lblk, size_t* path) const;
+    // frees the blocks [first, last) of the i-node and leaves holes
+    void unmap_blocks(uint16_t ino, size_t first, size_t last);
+    // clears the address and frees the indirect blocks left without addresses
+    void unmap_indirect(uint32_t& root, const size_t* path, size_t levels);
+    // points the logical block to addr, allocates the indirect blocks on the way
+    void bmap_set(uint16_t ino, size_t lblk, size_t addr);
+    // compressed i-nodes are written a cluster at a time
+    void write_clusters(uint16_t ino, uint64_t pos, uint64_t size, const char* buf);
+    // contents of the cluster, compressed or not, valid is the count of its blocks in the file
+    void store_cluster(uint16_t ino, size_t cluster, const char* data, size_t valid);
+    void load_cluster(const inode& in, size_t cluster, std::vector<char>& res);
+    // deduplicated i-nodes share the blocks with the same contents
+    void write_dedup(uint16_t ino, uint64_t pos, uint64_t size, const char* buf);
+    // block with the same contents as data, 0 if there is none
+    size_t dedup_find(const char* data, uint64_t hash);
+    // adds a block with a single reference to the hash index
+    void dedup_insert(size_t bno, uint64_t hash);
+    void dedup_remove(size_t bno);
+    dedup_record dedup_load(size_t bno);
+    void dedup_store(size_t bno, const dedup_record& rec);
+    // first block of the bucket of the hash, the table starts with the bucket heads
+    size_t dedup_bucket(uint64_t hash);
+    void set_dedup_bucket(uint64_t hash, size_t head);
+    // block and offset of the record of a block in the table, after the bucket heads
+    void dedup_record_pos(size_t bno, size_t& blk, size_t& off) const;
+    size_t dedup_bucket_count() const;
+    size_t dedup_table_blocks() const;
+    // drops a reference of a shared block, other blocks are freed
+    void free_data_block(size_t bno);
+    size_t new_indirect_block();
+    // ends the operation by making its writes durable, the logged metadata as one transaction
+    void sync();
+    // writes the blocks allocated by the operation to their places and leaves them out of logged
+    void write_fresh_blocks(std::vector<block_io>& logged);
+    // blocks of the log when the format doesn't give them
+    size_t default_journal_blocks() const;
 
     void get_all_occupied_names_blocks(std::map<size_t,std::set<std::string>>& name_map,
                                        std::map<size_t,std::vector<size_t>> &blk_map);
@@ -144,10 +323,48 @@ private:
 
 
 
-    uint16_t get_free_inode();
+    // the search starts from near, usually the parent directory, and wraps around
+    uint16_t get_free_inode(size_t near);
     void put_free_inode(uint16_t index);
-    uint16_t get_free_block();
-    void put_free_block(uint16_t bno);
+    // the search starts from hint when the image has a block bitmap
+    size_t get_free_block(size_t hint);
+    size_t get_free_block();
+    // with a journal the block is kept back until the operation is committed
+    void put_free_block(size_t bno);
+    // gives the block back to the bitmap or to the free block list
+    void free_block(size_t bno);
+    // bitmap bookkeeping of one block, also keeps the group counters
+    void take_block(size_t bno);
+    void release_block(size_t bno);
+    // takes count blocks at once, physically contiguous when the bitmap has such a run
+    void reserve_blocks(size_t count);
+    // gives back the reserved blocks that weren't used
+    void release_reserved();
+    // writes a whole file with its blocks reserved up front
+    void write_reserved(uint16_t inode_index, const std::vector<char>& buf, size_t block_count);
+    bool has_feature(uint32_t feature) const;
+    // conversion between the on disk format of the image and the in memory structures
+    void decode_superblock(const char* arr);
+    void encode_superblock(char* arr) const;
+    void decode_inode(const char* arr, inode& in) const;
+    void encode_inode(const inode& in, char* arr) const;
+    // superblock and group descriptor table, all in block 0 unless there are many groups
+    void write_superblock_blocks();
+    size_t gdt_blocks() const;
+    size_t superblock_size() const;
+    uint64_t max_file_size() const;
+    size_t total_block_count() const;
+    size_t inode_table_blocks() const;
+    // physical block of the i'th inode table or bitmap block
+    size_t itable_block_no(size_t i) const;
+    size_t bitmap_block_no(size_t i) const;
+    // first block after the metadata of a group
+    size_t group_data_start(size_t g) const;
+    void layout_groups(size_t total_blocks, size_t group_count);
+    // first block searched for the data of the inode
+    size_t block_hint(size_t ino) const;
+    // inode to start searching from for a new directory
+    size_t dir_inode_hint(size_t parent) const;
     // checks if the directory exists and if the file doesn't exists
     // returns true if the file exists
     bool new_file_args(const std::string &arg, std::string &path, std::string &name, size_t &parent,
@@ -163,29 +380,101 @@ private:
     void empty_inode_blocks(size_t iindex);
 
     void init_directory(data_block & db,uint16_t index, uint16_t parent);
-    void init_file(uint16_t index, size_t fsize);
-
-
-    std::vector<char> create_dir_entry(uint16_t index,const std::string& name) const;
+    void init_file(uint16_t index, size_t fsize, size_t type);
+
+
+    std::vector<char> create_dir_entry(uint16_t index,const std::string& name, uint8_t type) const;
+    // entry at off of the directory bytes, false when there are no more entries
+    bool next_dir_entry(const char* arr, size_t size, size_t off, dir_entry& ent) const;
+    void dir_start(dir_cursor& dc, const inode& dir);
+    // next entry of the directory, false after the last one, the name is valid until the next call
+    bool dir_next(dir_cursor& dc, dir_entry& ent);
+    // compares the name in place
+    static bool entry_is(const dir_entry& ent, const std::string& name);
+    // bytes taken by an entry with the given name length
+    size_t dir_record_size(size_t name_len) const;
+    size_t max_name_size() const;
+    // size of a directory with only . and ..
+    size_t empty_dir_size() const;
+    // appends the entry to the directory and its index
+    void add_dir_entry(size_t dir, uint16_t index, const std::string& name);
+    // hashed index of a directory, a root block of bucket addresses and chains of leaf
+    // blocks with copies of the directory entries, lookups don't read the directory
+    bool dir_index_lookup(const inode& dir, const std::string& name, size_t& index);
+    void dir_index_insert(size_t dir, const std::vector<char>& entry);
+    void dir_index_remove(size_t dir, const std::string& name);
+    void build_dir_index(size_t dir);
+    void load_index_blocks(const inode& dir, std::vector<size_t>& res);
+    void free_dir_index(size_t dir);
+    static uint32_t name_hash(const char* name, size_t len);
+    size_t index_bucket(const char* name, size_t len) const;
+    // offset after the last entry of an index leaf
+    size_t index_leaf_end(const data_block& blk) const;
+    // the hole is filled by the last entry or by the entries next to it in the block
     void remove_dir_entry(size_t iindex,const std::string& name);
-    void add_inode_size(size_t index, uint32_t size);
-    static uint32_t get_inode_size(const inode& i);
-    void load_inode_blocks_helper(size_t bno, size_t* size, size_t* rem_blocks, size_t level);
-
+    // offset of the last entry, prev is the entry before it in its block or the size when there is none
+    uint64_t last_dir_entry(size_t dir, uint64_t& prev);
+    // shrinks the directory, its last block is freed when it becomes empty
+    void remove_last_dir_entry(size_t dir);
+    // copy of the entry at pos of the directory with its natural length, rec_len is its length on the disk
+    std::vector<char> load_dir_entry(size_t dir, uint64_t pos, size_t& rec_len);
+    static void set_record_length(std::vector<char>& entry, size_t rec_len);
+    void add_inode_size(size_t index, uint64_t size);
+    static uint64_t get_inode_size(const inode& i);
+    // physical block of the logical block lblk, 0 if it is not allocated
+    size_t bmap(const inode& i, size_t lblk);
+    size_t indirect_address(size_t bno, size_t index);
+    // extents of the i-node, the inline ones and the ones in its extent block
+    void load_extents(const inode& i, std::vector<file_extent>& res);
+    void store_extents(size_t ino, const std::vector<file_extent>& ext);
+    size_t extent_bmap(const inode& i, size_t lblk);
+    size_t extent_alloc(uint16_t ino, size_t lblk);
+    // flags of a new or emptied i-node
+    uint16_t new_inode_flags() const;
+    size_t inline_capacity() const;
+    // moves the first keep bytes of an inline file to data blocks
+    void move_inline_data(uint16_t ino, size_t keep);
+    void ra_start(readahead& ra, const inode& i);
+    // next block of the inode, prefetches the upcoming blocks
+    data_block ra_next(readahead& ra);
+    void prefetch(const std::vector<size_t>& bnos);
+    size_t ra_max_window() const;
+    // data block numbers of the inode in file order
+    void load_block_map(const inode& i, std::vector<size_t>& res);
+    void load_block_map_helper(size_t bno, size_t* rem_blocks, size_t level, std::vector<size_t>& res);
+
+    // from the bitmap or by following the free block list
+    void load_free_blocks(std::vector<size_t>& res);
     void get_all_free_blocks(std::vector<size_t>& res,size_t pos);
+    void load_inode_map();
     void get_all_free_inodes(std::vector<size_t>& res,size_t * dir_count);
     void load_occupied_inode_blocks(size_t index, std::vector<size_t> &res);
     void load_occupied_inode_blocks_helper(size_t index, std::vector<size_t> &res, size_t address, size_t level);
 
     const char* filename = nullptr;
+    // image is opened once per session
+    block_device dev;
+    // buffers of the blocks, declared before everything that holds blocks
+    block_pool pool;
+    // every block read and written goes through the cache
+    buffer_cache cache{dev, pool, fs_options().cache_blocks};
+    // open with feature_journal
+    journal jrnl{dev};
+    // blocks freed in this operation, they are given back when it is committed
+    std::vector<size_t> held_blocks;
+    // blocks allocated in this operation, nothing that is durable points to them
+    std::set<size_t> fresh_blocks;
+    // names looked up in this session
+    dentry_cache dcache{dcache_entries};
     superblock sb;
     size_t block_size_byte;
     size_t node_cap;
     size_t block_cap;
-    static const size_t inode_size = 32;
+    // bytes of an on disk i-node and of a block address in an indirect block
+    size_t inode_size = 32;
+    size_t addr_size = 2;
     static const size_t direct_count = 5;
-    static const size_t write_buffer_size = 64;
-    static const int max_file_size = 1 << 20;
+    static const uint64_t v1_max_file_size = 1 << 20;
     static const char months[][4];
     static const size_t empty_type = 0;
     static const size_t dir_type = 1;
@@ -193,10 +482,65 @@ private:
     static const size_t sym_dir = 3;
     static const size_t sym_file = 4;
     static const size_t dir_name_size = 6;
+    // with feature_long_names
+    static const size_t long_entry_header = 6;
+    static const size_t max_long_name_size = 255;
+    // entry count and next leaf of an index leaf
+    static const size_t index_leaf_header = 8;
+    static const size_t ra_initial_window = 4;
+    static const size_t ra_window_limit = 128;
+    // bytes read at once by scrub
+    static const size_t scrub_batch_bytes = 8 << 20;
+    // default journal size is a part of the image between these
+    static const size_t min_journal_blocks = 64;
+    static const size_t max_journal_blocks = 256;
+    static const size_t dcache_entries = 1 << 16;
+    static const uint32_t sb_magic = 0x53464d4f;
+    // the group descriptor table is at this offset of block 0
+    static const size_t gdt_offset = 128;
+    // size of the superblock without the magic and the features
+    static const size_t v1_superblock_size = 16;
+    static const size_t v2_inode_size = 64;
+    // i-node flag, the block map is kept in extents
+    static const uint16_t inode_extents = 1;
+    // i-node flag, the contents are in the i-node
+    static const uint16_t inode_inline_data = 2;
+    // i-node flag, the directory has a hashed index
+    static const uint16_t inode_dir_index = 4;
+    // the blocks are mapped in clusters, a compressed cluster fills its slots after the data with compressed_block
+    static const uint16_t inode_compressed = 8;
+    // i-node flag, the data blocks are deduplicated and may be shared with other i-nodes
+    static const uint16_t inode_dedup = 16;
+    static const uint32_t compressed_block = 0xFFFFFFFF;
+    // length of the compressed data before it
+    static const size_t cluster_header = 4;
+    static const size_t inline_inode_size = 128;
+    static const size_t inline_extents = 3;
+    // largest group so that its counters fit the group descriptor
+    static const size_t max_blocks_per_group = 32768;
     // System RAM simulation
     std::vector<inode> inodes;
-    std::vector<data_block> inode_blocks;
+    // dirty bits of the metadata, flushed once per operation
+    bool sb_dirty = false;
+    std::vector<bool> itable_dirty;
+    // free blocks of the images with feature_bitmap, one bitmap block per group with feature_groups
+    block_bitmap bitmap;
+    std::vector<group_desc> groups;
+    // new blocks are searched after the last allocated one
+    size_t alloc_hint = 0;
+    // blocks of the file being written and the next one to hand out
+    std::vector<size_t> reserved;
+    size_t reserved_next = 0;
+    // used inodes, built from the inode table when the image is opened
+    block_bitmap inode_map;
+    // readahead statistics
+    size_t ra_blocks = 0;
+    size_t ra_max_used = 0;
     std::vector<data_block> temp_blocks;
+    // read in place of the blocks of a hole
+    std::vector<char> hole_block;
+    // blocks whose checksums were verified or written in this session
+    std::vector<bool> csum_verified;
 
 };
 
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include "journal.h"
+#include "crc32c.h"
+
+using namespace std;
+
+const size_t journal::min_blocks;
+
+journal::journal(block_device &dev) : dev(dev) {
+}
+
+void journal::format(block_device &dev, size_t pos, size_t blocks, size_t block_size) {
+    if (blocks < min_blocks)
+        throw invalid_argument("Journal should have at least " + to_string(min_blocks) + " blocks.");
+    write_header(dev, pos, blocks, block_size, 1, 1);
+}
+
+void journal::write_header(block_device &dev, size_t pos, size_t blocks, size_t block_size,
+                           uint32_t seq, size_t checked) {
+    vector<char> buf(block_size, 0);
+    log_header h{header_magic, seq, (uint32_t) blocks, (uint32_t) checked, 0};
+    h.checksum = crc32c::of((const char*) &h, sizeof(h));
+    memcpy(buf.data(), &h, sizeof(h));
+    dev.write_block(pos, buf.data());
+}
+
+void journal::open(size_t pos_arg, size_t blocks_arg, size_t block_size_arg, size_t sync_interval_arg) {
+    pos = pos_arg;
+    blocks = blocks_arg;
+    block_size = block_size_arg;
+    sync_interval = max<size_t>(1, sync_interval_arg);
+    vector<char> buf(block_size);
+    dev.read_block(pos, buf.data());
+    log_header h;
+    memcpy(&h, buf.data(), sizeof(h));
+    uint32_t sum = h.checksum;
+    h.checksum = 0;
+    if (h.magic != header_magic || h.blocks != blocks || crc32c::of((const char*) &h, sizeof(h)) != sum)
+        throw runtime_error("Journal header is corrupted.");
+    first_seq = next_seq = h.seq;
+    head = 1;
+    // the log is read up to a bit after the last sync at once, then in pieces that double,
+    // blocks [1, loaded) are in data
+    vector<char> data;
+    size_t loaded = 1;
+    auto load = [&](size_t end) {
+        if (end <= loaded)
+            return true;
+        if (end > blocks)
+            return false;
+        size_t to = min(blocks, max(end, max<size_t>(h.checked, 2 * loaded) + initial_read_blocks));
+        data.resize((to - 1) * block_size);
+        dev.read_at((pos + loaded) * block_size, &data[(loaded - 1) * block_size], (to - loaded) * block_size);
+        loaded = to;
+        return true;
+    };
+    // the blocks of a transaction are remapped once its last descriptor is read
+    vector<pair<size_t, size_t>> pending;
+    size_t at = head;
+    while (load(at + 1)) {
+        descriptor d;
+        memcpy(&d, &data[(at - 1) * block_size], sizeof(d));
+        // a stale descriptor of an older transaction ends the log
+        if (d.magic != descriptor_magic || d.seq != next_seq || d.count == 0 ||
+            d.count > descriptor_capacity() || !load(at + 1 + d.count))
+            break;
+        char* desc = &data[(at - 1) * block_size];
+        memset(desc + offsetof(descriptor, checksum), 0, sizeof(d.checksum));
+        // only the ones after the last sync can be torn
+        if (at >= h.checked && crc32c::of(desc, (1 + d.count) * block_size) != d.checksum)
+            break;
+        for (size_t k = 0; k < d.count; ++k) {
+            uint32_t bno;
+            memcpy(&bno, desc + sizeof(d) + k * sizeof(bno), sizeof(bno));
+            pending.emplace_back(bno, pos + at + 1 + k);
+        }
+        bool unsynced = at >= h.checked;
+        at += 1 + d.count;
+        if (d.last) {
+            unsynced_frees = unsynced_frees || (unsynced && d.frees);
+            for (auto& p : pending)
+                dev.remap(p.first, p.second);
+            pending.clear();
+            head = at;
+            next_seq++;
+            replayed++;
+        }
+    }
+    synced = min<size_t>(max<size_t>(h.checked, 1), head);
+}
+
+bool journal::is_open() const {
+    return blocks != 0;
+}
+
+void journal::commit(const vector<block_io> &blks, bool frees) {
+    if (blks.empty())
+        return;
+    // none of the blocks can be in its place before the whole transaction is in the log
+    if (!fits(blks.size()))
+        throw length_error("Operation changes more metadata blocks than the journal can hold.");
+    size_t per_desc = descriptor_capacity();
+    size_t desc_count = (blks.size() + per_desc - 1) / per_desc;
+    size_t need = desc_count + blks.size();
+    if (head + need > blocks)
+        checkpoint();
+    vector<char> descs(desc_count * block_size, 0);
+    vector<block_io> reqs;
+    size_t at = pos + head;
+    for (size_t i = 0; i < desc_count; ++i) {
+        size_t first = i * per_desc;
+        size_t count = min(per_desc, blks.size() - first);
+        char* buf = &descs[i * block_size];
+        descriptor d{descriptor_magic, next_seq, (uint32_t) count, i + 1 == desc_count, frees, 0};
+        memcpy(buf, &d, sizeof(d));
+        for (size_t k = 0; k < count; ++k) {
+            auto bno = (uint32_t) blks[first + k].bno;
+            memcpy(buf + sizeof(d) + k * sizeof(bno), &bno, sizeof(bno));
+        }
+        uint32_t crc = crc32c::of(buf, block_size);
+        for (size_t k = 0; k < count; ++k)
+            crc = crc32c::of(blks[first + k].buf, block_size, crc);
+        memcpy(buf + offsetof(descriptor, checksum), &crc, sizeof(crc));
+        reqs.push_back(block_io{at++, buf});
+        for (size_t k = 0; k < count; ++k)
+            reqs.push_back(block_io{at++, blks[first + k].buf});
+    }
+    // the whole transaction is one contiguous write
+    dev.write_blocks(reqs);
+    for (auto& req : reqs) {
+        if (req.buf < descs.data() || req.buf >= descs.data() + descs.size())
+            continue;
+        descriptor d;
+        memcpy(&d, req.buf, sizeof(d));
+        for (size_t k = 0; k < d.count; ++k) {
+            uint32_t bno;
+            memcpy(&bno, req.buf + sizeof(d) + k * sizeof(bno), sizeof(bno));
+            dev.remap(bno, req.bno + 1 + k);
+        }
+    }
+    head += need;
+    unsynced_frees = unsynced_frees || frees;
+    committed++;
+    logged_blocks += blks.size();
+    // group commit, one sync makes the transactions before it durable too
+    if (next_seq++ % sync_interval == 0)
+        sync();
+}
+
+void journal::sync() {
+    if (head == synced)
+        return;
+    dev.sync_all();
+    write_header(dev, pos, blocks, block_size, first_seq, head);
+    synced = head;
+    unsynced_frees = false;
+}
+
+bool journal::has_unsynced_frees() const {
+    return unsynced_frees;
+}
+
+bool journal::fits(size_t count) const {
+    size_t per_desc = descriptor_capacity();
+    // block 0 of the log is the header
+    return (count + per_desc - 1) / per_desc + count < blocks;
+}
+
+void journal::checkpoint() {
+    if (next_seq == first_seq)
+        return;
+    vector<pair<size_t, size_t>> copies;
+    dev.get_remaps(copies);
+    vector<char> data(copies.size() * block_size);
+    vector<block_io> reqs;
+    for (size_t i = 0; i < copies.size(); ++i)
+        reqs.push_back(block_io{copies[i].second, &data[i * block_size]});
+    dev.read_blocks(reqs);
+    // the log has to be durable before its blocks are overwritten in their places
+    dev.sync_all();
+    dev.clear_remaps();
+    for (size_t i = 0; i < copies.size(); ++i)
+        reqs[i].bno = copies[i].first;
+    dev.write_blocks(reqs);
+    dev.sync_all();
+    // the old transactions don't have the sequence number of the header anymore
+    write_header(dev, pos, blocks, block_size, next_seq, 1);
+    first_seq = next_seq;
+    head = 1;
+    synced = 1;
+    unsynced_frees = false;
+    checkpoints++;
+}
+
+size_t journal::used_blocks() const {
+    return head;
+}
+
+size_t journal::transaction_count() const {
+    return next_seq - first_seq;
+}
+
+size_t journal::descriptor_capacity() const {
+    return (block_size - sizeof(descriptor)) / sizeof(uint32_t);
+}
+
+void journal::print_stats() const {
+    fprintf(stderr, "journal: replayed: %zu transactions: %zu (%zu blocks) checkpoints: %zu used: %zu of %zu blocks\n",
+            replayed, committed, logged_blocks, checkpoints, head, blocks);
+}
@@ -0,0 +1,101 @@
+#ifndef OS_MIDTERM_JOURNAL_H
+#define OS_MIDTERM_JOURNAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "block_device.h"
+
+/* Write ahead log of metadata blocks in a region of the image. The blocks
+ * changed by an operation are appended as one transaction: descriptor blocks
+ * with their numbers and a CRC32C of the descriptor and the copies after it.
+ * The device reads a logged block from its latest copy, so the blocks are
+ * written to their places only when the log is full (a checkpoint). When the
+ * image is opened the transactions are read up to the first torn one, so an
+ * operation is either found completely or not at all. The log is synced once
+ * for a number of transactions instead of once for each of them, the header
+ * then records that the transactions before the sync don't have to be
+ * checked again. A transaction that freed blocks is marked, so the file
+ * system knows to sync before it writes one of them in place. */
+class journal {
+public:
+    // enough for the transaction of any operation that doesn't write a file
+    static const size_t min_blocks = 16;
+
+    explicit journal(block_device& dev);
+
+    // writes the header of an empty log at [pos, pos + blocks)
+    static void format(block_device& dev, size_t pos, size_t blocks, size_t block_size);
+    // reads the transactions since the last checkpoint and points the device at the
+    // copies of their blocks, the log is synced after every sync_interval transactions
+    void open(size_t pos, size_t blocks, size_t block_size, size_t sync_interval);
+    bool is_open() const;
+    // appends the blocks as one transaction, frees tells that the operation freed blocks,
+    // throws if they don't fit in the log
+    void commit(const std::vector<block_io>& blocks, bool frees);
+    // makes the transactions so far durable
+    void sync();
+    // a transaction that freed blocks isn't durable yet, a crash would give them back to their owners
+    bool has_unsynced_frees() const;
+    // a transaction of count blocks fits in the log
+    bool fits(size_t count) const;
+    // writes the latest copies to their places and empties the log
+    void checkpoint();
+    // blocks of the log in use and transactions in them
+    size_t used_blocks() const;
+    size_t transaction_count() const;
+
+    void print_stats() const;
+
+private:
+    struct log_header {
+        uint32_t magic;
+        // sequence number of the first transaction after the header
+        uint32_t seq;
+        uint32_t blocks;
+        // the transactions before this block were synced, their checksums aren't verified again
+        uint32_t checked;
+        uint32_t checksum;
+    };
+    // followed by count block numbers, the copies come after the descriptor
+    struct descriptor {
+        uint32_t magic;
+        uint32_t seq;
+        uint32_t count;
+        // the last descriptor of the transaction
+        uint32_t last;
+        // the transaction freed blocks
+        uint32_t frees;
+        uint32_t checksum;
+    };
+
+    static void write_header(block_device& dev, size_t pos, size_t blocks, size_t block_size,
+                             uint32_t seq, size_t checked);
+    size_t descriptor_capacity() const;
+
+    static const uint32_t header_magic = 0x4a4c4f47;
+    static const uint32_t descriptor_magic = 0x4a444553;
+    // blocks read at once when the log is opened, doubled as the log goes on
+    static const size_t initial_read_blocks = 32;
+
+    block_device& dev;
+    size_t pos = 0;
+    size_t blocks = 0;
+    size_t block_size = 0;
+    size_t sync_interval = 1;
+    // sequence numbers of the first transaction in the log and of the next one
+    uint32_t first_seq = 0;
+    uint32_t next_seq = 0;
+    // next free block of the log counted from pos, block 0 is the header
+    size_t head = 0;
+    // the transactions before this block were synced
+    size_t synced = 0;
+    bool unsynced_frees = false;
+    size_t committed = 0;
+    size_t logged_blocks = 0;
+    size_t checkpoints = 0;
+    size_t replayed = 0;
+};
+
+
+#endif //OS_MIDTERM_JOURNAL_H
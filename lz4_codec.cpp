@@ -0,0 +1,166 @@
+#include <cstring>
+#include <stdexcept>
+#include "lz4_codec.h"
+
+using namespace std;
+
+const size_t lz4_codec::min_match;
+const size_t lz4_codec::last_literals;
+const size_t lz4_codec::match_limit;
+const size_t lz4_codec::max_offset;
+const size_t lz4_codec::hash_log;
+
+static uint32_t read32(const uint8_t* p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+uint32_t lz4_codec::hash(uint32_t seq) {
+    return (seq * 2654435761u) >> (32 - hash_log);
+}
+
+size_t lz4_codec::common_length(const uint8_t *a, const uint8_t *b, size_t limit) {
+    size_t len = 0;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // eight bytes are compared at once, the first different byte is the lowest set one
+    while (len + 8 <= limit) {
+        uint64_t x, y;
+        memcpy(&x, a + len, 8);
+        memcpy(&y, b + len, 8);
+        if (x != y)
+            return len + __builtin_ctzll(x ^ y) / 8;
+        len += 8;
+    }
+#endif
+    while (len < limit && a[len] == b[len])
+        len++;
+    return len;
+}
+
+bool lz4_codec::put_length(uint8_t *&out, const uint8_t *end, size_t len) {
+    while (len >= 255) {
+        if (out == end)
+            return false;
+        *out++ = 255;
+        len -= 255;
+    }
+    if (out == end)
+        return false;
+    *out++ = (uint8_t) len;
+    return true;
+}
+
+size_t lz4_codec::compress(const char *src, size_t len, char *dst, size_t cap) {
+    const uint8_t* in = (const uint8_t*) src;
+    uint8_t* out = (uint8_t*) dst;
+    const uint8_t* out_end = out + cap;
+    size_t anchor = 0;
+    if (len > match_limit) {
+        uint32_t table[1 << hash_log];
+        memset(table, 0, sizeof(table));
+        size_t ip = 1;
+        size_t misses = 0;
+        while (ip + match_limit < len) {
+            uint32_t seq = read32(in + ip);
+            uint32_t& slot = table[hash(seq)];
+            size_t ref = slot;
+            slot = (uint32_t) ip;
+            if (ip - ref > max_offset || read32(in + ref) != seq) {
+                // steps get longer on data that doesn't compress
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+            // the match is extended backwards over the pending literals
+            while (ip > anchor && ref > 0 && in[ip - 1] == in[ref - 1]) {
+                ip--;
+                ref--;
+            }
+            size_t mlen = min_match + common_length(in + ip + min_match, in + ref + min_match,
+                                                    len - last_literals - ip - min_match);
+            size_t lit = ip - anchor;
+            // token, literal length bytes, literals and the offset
+            if ((size_t) (out_end - out) < 1 + lit / 255 + 1 + lit + 2)
+                return 0;
+            uint8_t* token = out++;
+            *token = (uint8_t) (min<size_t>(lit, 15) << 4);
+            if (lit >= 15)
+                put_length(out, out_end, lit - 15);
+            memcpy(out, in + anchor, lit);
+            out += lit;
+            *out++ = (uint8_t) (ip - ref);
+            *out++ = (uint8_t) ((ip - ref) >> 8);
+            *token |= (uint8_t) min<size_t>(mlen - min_match, 15);
+            if (mlen - min_match >= 15 && !put_length(out, out_end, mlen - min_match - 15))
+                return 0;
+            ip += mlen;
+            anchor = ip;
+            if (ip + match_limit < len)
+                table[hash(read32(in + ip - 2))] = (uint32_t) (ip - 2);
+        }
+    }
+    // the rest is a sequence of literals without a match
+    size_t lit = len - anchor;
+    if ((size_t) (out_end - out) < 1 + lit / 255 + 1 + lit)
+        return 0;
+    uint8_t* token = out++;
+    *token = (uint8_t) (min<size_t>(lit, 15) << 4);
+    if (lit >= 15)
+        put_length(out, out_end, lit - 15);
+    memcpy(out, in + anchor, lit);
+    out += lit;
+    return out - (uint8_t*) dst;
+}
+
+size_t lz4_codec::decompress(const char *src, size_t len, char *dst, size_t cap) {
+    const uint8_t* in = (const uint8_t*) src;
+    uint8_t* out = (uint8_t*) dst;
+    size_t ip = 0, op = 0;
+    while (ip < len) {
+        uint8_t token = in[ip++];
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            uint8_t b;
+            do {
+                if (ip >= len)
+                    throw runtime_error("Compressed data is corrupted.");
+                b = in[ip++];
+                lit += b;
+            } while (b == 255);
+        }
+        if (lit > len - ip || lit > cap - op)
+            throw runtime_error("Compressed data is corrupted.");
+        memcpy(out + op, in + ip, lit);
+        ip += lit;
+        op += lit;
+        // the last sequence has no match
+        if (ip == len)
+            break;
+        if (len - ip < 2)
+            throw runtime_error("Compressed data is corrupted.");
+        size_t offset = in[ip] | ((size_t) in[ip + 1] << 8);
+        ip += 2;
+        size_t mlen = token & 15;
+        if (mlen == 15) {
+            uint8_t b;
+            do {
+                if (ip >= len)
+                    throw runtime_error("Compressed data is corrupted.");
+                b = in[ip++];
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += min_match;
+        if (offset == 0 || offset > op || mlen > cap - op)
+            throw runtime_error("Compressed data is corrupted.");
+        // an overlapping match repeats the last offset bytes, the copied part
+        // doubles every step while it stays a multiple of offset
+        for (size_t done = 0, n = 0; done < mlen; done += n) {
+            n = min(done + offset, mlen - done);
+            memcpy(out + op + done, out + op - offset, n);
+        }
+        op += mlen;
+    }
+    return op;
+}
@@ -0,0 +1,34 @@
+#ifndef OS_MIDTERM_LZ4_CODEC_H
+#define OS_MIDTERM_LZ4_CODEC_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* Compressor and decompressor of the LZ4 block format. Matches are searched
+ * greedily with a hash table holding the last position of every 4 byte
+ * sequence, the table is skipped through faster while nothing matches. */
+class lz4_codec {
+public:
+    // size of the compressed data, 0 when it doesn't fit in cap bytes
+    static size_t compress(const char* src, size_t len, char* dst, size_t cap);
+    // size of the decompressed data, throws if the data is corrupted or larger than cap
+    static size_t decompress(const char* src, size_t len, char* dst, size_t cap);
+
+private:
+    lz4_codec() = default;
+    static uint32_t hash(uint32_t seq);
+    // length of the common prefix of a and b, at most limit bytes
+    static size_t common_length(const uint8_t* a, const uint8_t* b, size_t limit);
+    // writes the 255 bytes of a length after its token, false if there is no room
+    static bool put_length(uint8_t*& out, const uint8_t* end, size_t len);
+
+    static const size_t min_match = 4;
+    // the last bytes are always literals and the last match starts before them
+    static const size_t last_literals = 5;
+    static const size_t match_limit = 12;
+    static const size_t max_offset = 65535;
+    static const size_t hash_log = 12;
+};
+
+
+#endif //OS_MIDTERM_LZ4_CODEC_H
@@ -12,8 +12,9 @@ using namespace std;
 int main(int argc, const char ** argv){
     try {
         int bs,ic;
-        args_reader::mfs(argc,argv,&bs,&ic);
-        file_system fs(bs,ic);
+        format_options format;
+        args_reader::mfs(argc,argv,&bs,&ic,&format);
+        file_system fs(bs,ic,format);
         fs.create_file(argv[3]);
     }
     catch (exception& e){
@@ -0,0 +1,28 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=1
+./makeFileSystem 1 400 mySystem.dat long_names
+./fileSystemOper mySystem.dat mkdir "/usr"
+# names of 30 bytes and more, the directory takes several blocks and has no index
+for i in $(seq 1 100); do
+    ./fileSystemOper mySystem.dat write "/usr/a_file_with_a_rather_long_name_$i" linuxFile.data
+done
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_1" linuxFile2.data
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_100" linuxFile3.data
+md5sum linuxFile.data linuxFile2.data linuxFile3.data
+# deletes in the middle of the directory, the last entries take their places
+for i in $(seq 40 60); do
+    ./fileSystemOper mySystem.dat del "/usr/a_file_with_a_rather_long_name_$i"
+done
+# the deleted file isn't found, the moved one still is
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_50" linuxFile4.data
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_99" linuxFile2.data
+# the deleted names are added again
+for i in $(seq 40 60); do
+    ./fileSystemOper mySystem.dat write "/usr/a_file_with_a_rather_long_name_$i" linuxFile.data
+done
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_50" linuxFile3.data
+md5sum linuxFile.data linuxFile2.data linuxFile3.data
+./fileSystemOper mySystem.dat list "/usr"
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file
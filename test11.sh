@@ -0,0 +1,26 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=300
+echo "a small file" > smallFile.data
+# every format is filled and emptied again, the free block and i-node counts
+# must be back to the ones of the new image
+for features in "" bitmap groups=4 v2 extents inline_data size=8M; do
+    echo "Features: $features"
+    ./makeFileSystem 1 400 mySystem.dat $features
+    ./fileSystemOper mySystem.dat dumpe2fs | sed "s/\x1b\[[0-9;]*m//g" | grep "^Free .* Count" > freeCounts.txt
+    ./fileSystemOper mySystem.dat mkdir "/usr"
+    ./fileSystemOper mySystem.dat write "/usr/file1" linuxFile.data
+    ./fileSystemOper mySystem.dat write "/usr/small" smallFile.data
+    ./fileSystemOper mySystem.dat ln "/usr/file1" "/usr/file2"
+    ./fileSystemOper mySystem.dat read "/usr/file2" linuxFile2.data
+    ./fileSystemOper mySystem.dat read "/usr/small" smallFile2.data
+    md5sum linuxFile.data linuxFile2.data smallFile.data smallFile2.data
+    ./fileSystemOper mySystem.dat del "/usr/file1"
+    ./fileSystemOper mySystem.dat read "/usr/file2" linuxFile2.data
+    md5sum linuxFile.data linuxFile2.data
+    ./fileSystemOper mySystem.dat del "/usr/file2"
+    ./fileSystemOper mySystem.dat del "/usr/small"
+    ./fileSystemOper mySystem.dat rmdir "/usr"
+    ./fileSystemOper mySystem.dat dumpe2fs | sed "s/\x1b\[[0-9;]*m//g" | grep "^Free .* Count" > freeCounts2.txt
+    diff freeCounts.txt freeCounts2.txt && cat freeCounts2.txt
+done
\ No newline at end of file
@@ -0,0 +1,17 @@
+make clean
+make
+./makeFileSystem 1 100 mySystem.dat journal=16
+./fileSystemOper mySystem.dat mkdir "/usr"
+./fileSystemOper mySystem.dat mkdir "/bin"
+./fileSystemOper mySystem.dat dumpe2fs
+# the last transaction ends at the last block the log uses, zeroing it cuts the transaction off
+last=$(./fileSystemOper mySystem.dat dumpe2fs | sed "s/\x1b\[[0-9;]*m//g" | sed -n "s/^Journal: \([0-9]*\) .* in \([0-9]*\) blocks.*/\1 + \2 - 1/p")
+dd if=/dev/zero of=mySystem.dat bs=1K seek=$(($last)) count=1 conv=notrunc
+# /usr is read from the log, /bin is gone
+./fileSystemOper mySystem.dat list "/"
+./fileSystemOper mySystem.dat fsck
+./fileSystemOper mySystem.dat mkdir "/bin"
+./fileSystemOper mySystem.dat mkdir "/bin/ysa"
+./fileSystemOper mySystem.dat list "/"
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file
@@ -0,0 +1,14 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=100
+./makeFileSystem 1 400 mySystem.dat sparse
+./fileSystemOper mySystem.dat write "/file1" linuxFile.data
+./fileSystemOper mySystem.dat punch "/file1" 4096 65536
+./fileSystemOper mySystem.dat read "/file1" linuxFile2.data
+# the punched range reads as zeros and the rest of the file stays the same
+cp linuxFile.data linuxFile3.data
+dd if=/dev/zero of=linuxFile3.data bs=1K seek=4 count=64 conv=notrunc
+md5sum linuxFile2.data linuxFile3.data
+./fileSystemOper mySystem.dat list "/"
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file
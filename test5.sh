@@ -0,0 +1,20 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=1
+./makeFileSystem 1 400 mySystem.dat long_names dir_index
+./fileSystemOper mySystem.dat mkdir "/usr"
+for i in $(seq 1 100); do
+    ./fileSystemOper mySystem.dat write "/usr/a_file_with_a_rather_long_name_$i" linuxFile.data
+done
+./fileSystemOper mySystem.dat list "/usr"
+# the last entry takes the place of a deleted one in the middle of the directory
+./fileSystemOper mySystem.dat del "/usr/a_file_with_a_rather_long_name_50"
+./fileSystemOper mySystem.dat del "/usr/a_file_with_a_rather_long_name_51"
+./fileSystemOper mySystem.dat list "/usr"
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_100" linuxFile2.data
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_52" linuxFile3.data
+# the deleted file isn't found any more
+./fileSystemOper mySystem.dat read "/usr/a_file_with_a_rather_long_name_50" linuxFile4.data
+md5sum linuxFile.data linuxFile2.data linuxFile3.data
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file
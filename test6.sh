@@ -0,0 +1,13 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=100
+seq 1 100000 > linuxText.data
+./makeFileSystem 4 400 mySystem.dat size=64M compress=8
+./fileSystemOper mySystem.dat write "/text" linuxText.data
+./fileSystemOper mySystem.dat write "/random" linuxFile.data
+./fileSystemOper mySystem.dat read "/text" linuxText2.data
+./fileSystemOper mySystem.dat read "/random" linuxFile2.data
+md5sum linuxText.data linuxText2.data linuxFile.data linuxFile2.data
+./fileSystemOper mySystem.dat list "/"
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file
@@ -0,0 +1,15 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=100
+./makeFileSystem 1 400 mySystem.dat dedup
+./fileSystemOper mySystem.dat write "/file1" linuxFile.data
+./fileSystemOper mySystem.dat write "/file2" linuxFile.data
+./fileSystemOper mySystem.dat write "/file3" linuxFile.data
+./fileSystemOper mySystem.dat dumpe2fs
+# the shared blocks stay until their last file is deleted
+./fileSystemOper mySystem.dat del "/file1"
+./fileSystemOper mySystem.dat del "/file2"
+./fileSystemOper mySystem.dat read "/file3" linuxFile2.data
+md5sum linuxFile.data linuxFile2.data
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file
@@ -0,0 +1,15 @@
+make clean
+make
+yes "linux file data" | head -c 20000 > linuxFile.data
+./makeFileSystem 1 100 mySystem.dat metadata_csum data_csum
+./fileSystemOper mySystem.dat write "/file1" linuxFile.data
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat scrub
+# one byte of the first block of /file1 is changed, reading the file fails on its checksum
+blk=$(./fileSystemOper mySystem.dat dumpe2fs | sed "s/\x1b\[[0-9;]*m//g" | grep -A1 "^Inode: 1$" | sed -n "s/^Occupied Blocks: \([0-9]*\).*/\1/p")
+printf "X" | dd of=mySystem.dat bs=1 seek=$(($blk * 1024 + 100)) conv=notrunc
+./fileSystemOper mySystem.dat read "/file1" linuxFile2.data
+# one byte of an unused i-node in the first block of the i-node table, after the superblock
+printf "X" | dd of=mySystem.dat bs=1 seek=$((1024 + 1000)) conv=notrunc
+# both blocks are listed
+./fileSystemOper mySystem.dat scrub
\ No newline at end of file
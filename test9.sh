@@ -0,0 +1,28 @@
+make clean
+make
+dd if=/dev/urandom of=linuxFile.data bs=1K count=1
+./makeFileSystem 1 400 mySystem.dat dir_index
+./fileSystemOper mySystem.dat mkdir "/usr"
+# 8 byte entries, 128 fit in a block, the directory gets its index when it grows past one
+for i in $(seq 1 200); do
+    ./fileSystemOper mySystem.dat write "/usr/f$i" linuxFile.data
+done
+./fileSystemOper mySystem.dat read "/usr/f1" linuxFile2.data
+./fileSystemOper mySystem.dat read "/usr/f200" linuxFile3.data
+md5sum linuxFile.data linuxFile2.data linuxFile3.data
+# deletes in the middle of the directory, the last entries take their places
+for i in $(seq 60 80); do
+    ./fileSystemOper mySystem.dat del "/usr/f$i"
+done
+# the deleted file isn't found, the moved one still is
+./fileSystemOper mySystem.dat read "/usr/f70" linuxFile4.data
+./fileSystemOper mySystem.dat read "/usr/f199" linuxFile2.data
+# the deleted names are added again
+for i in $(seq 60 80); do
+    ./fileSystemOper mySystem.dat write "/usr/f$i" linuxFile.data
+done
+./fileSystemOper mySystem.dat read "/usr/f70" linuxFile3.data
+md5sum linuxFile.data linuxFile2.data linuxFile3.data
+./fileSystemOper mySystem.dat list "/usr"
+./fileSystemOper mySystem.dat dumpe2fs
+./fileSystemOper mySystem.dat fsck
\ No newline at end of file